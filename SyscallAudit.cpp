@@ -0,0 +1,487 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp Plugin Tester
+    Chris Cannam, cannam@all-day-breakfast.com
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2009-2014 QMUL.
+
+    This program loads a Vamp plugin and tests its susceptibility to a
+    number of common pitfalls, including handling of extremes of input
+    data.  If you can think of any additional useful tests that are
+    easily added, please send them to me.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+#include "SyscallAudit.h"
+
+// This file deliberately avoids including the system headers that
+// declare the functions it defines, since their declarations vary in
+// exception specification and attributes between C library versions
+
+#ifdef __linux__
+
+#include <atomic>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <linux/fcntl.h> // O_CREAT and O_TMPFILE, without declaring open
+
+#ifndef O_TMPFILE
+#define O_TMPFILE 0
+#endif
+
+// Number of threads currently auditing. While it is zero, as it is
+// outside J2, the wrappers go straight through to the real calls
+// without touching any thread-local state
+static std::atomic<int> auditing(0);
+
+static thread_local bool counting = false;
+static thread_local int counts[SyscallAudit::Calls];
+
+static inline bool
+active()
+{
+    return auditing.load(std::memory_order_relaxed) > 0 && counting;
+}
+
+static inline void
+tally(SyscallAudit::Call c)
+{
+    if (active()) ++counts[c];
+}
+
+// Look up the next definition of the named function, i.e. the real
+// one in the C library, the first time it is needed. The lookup is
+// a function-local static initialisation, which C++11 makes safe
+// when several threads make their first call at once
+#define REAL(fn, ret, args) \
+    typedef ret (*Fn) args; \
+    static const Fn real = (Fn)dlsym(RTLD_NEXT, fn);
+
+// The mode argument to open and its relatives is only present when
+// the flags call for a file to be created
+static bool
+hasMode(int flags)
+{
+    return (flags & O_CREAT) || (O_TMPFILE && (flags & O_TMPFILE) == O_TMPFILE);
+}
+
+extern "C" {
+
+int open(const char *path, int flags, ...)
+{
+    REAL("open", int, (const char *, int, ...));
+    tally(SyscallAudit::Open);
+    if (!hasMode(flags)) return real(path, flags);
+    va_list ap;
+    va_start(ap, flags);
+    int mode = va_arg(ap, int);
+    va_end(ap);
+    return real(path, flags, mode);
+}
+
+int open64(const char *path, int flags, ...)
+{
+    REAL("open64", int, (const char *, int, ...));
+    tally(SyscallAudit::Open);
+    if (!hasMode(flags)) return real(path, flags);
+    va_list ap;
+    va_start(ap, flags);
+    int mode = va_arg(ap, int);
+    va_end(ap);
+    return real(path, flags, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...)
+{
+    REAL("openat", int, (int, const char *, int, ...));
+    tally(SyscallAudit::Open);
+    if (!hasMode(flags)) return real(dirfd, path, flags);
+    va_list ap;
+    va_start(ap, flags);
+    int mode = va_arg(ap, int);
+    va_end(ap);
+    return real(dirfd, path, flags, mode);
+}
+
+int openat64(int dirfd, const char *path, int flags, ...)
+{
+    REAL("openat64", int, (int, const char *, int, ...));
+    tally(SyscallAudit::Open);
+    if (!hasMode(flags)) return real(dirfd, path, flags);
+    va_list ap;
+    va_start(ap, flags);
+    int mode = va_arg(ap, int);
+    va_end(ap);
+    return real(dirfd, path, flags, mode);
+}
+
+// The checked variants called from code built with _FORTIFY_SOURCE,
+// used when there is no mode argument
+
+int __open_2(const char *path, int flags)
+{
+    REAL("__open_2", int, (const char *, int));
+    tally(SyscallAudit::Open);
+    return real(path, flags);
+}
+
+int __open64_2(const char *path, int flags)
+{
+    REAL("__open64_2", int, (const char *, int));
+    tally(SyscallAudit::Open);
+    return real(path, flags);
+}
+
+int __openat_2(int dirfd, const char *path, int flags)
+{
+    REAL("__openat_2", int, (int, const char *, int));
+    tally(SyscallAudit::Open);
+    return real(dirfd, path, flags);
+}
+
+int __openat64_2(int dirfd, const char *path, int flags)
+{
+    REAL("__openat64_2", int, (int, const char *, int));
+    tally(SyscallAudit::Open);
+    return real(dirfd, path, flags);
+}
+
+void *fopen(const char *path, const char *mode)
+{
+    REAL("fopen", void *, (const char *, const char *));
+    tally(SyscallAudit::Open);
+    return real(path, mode);
+}
+
+void *fopen64(const char *path, const char *mode)
+{
+    REAL("fopen64", void *, (const char *, const char *));
+    tally(SyscallAudit::Open);
+    return real(path, mode);
+}
+
+ssize_t read(int fd, void *buf, size_t n)
+{
+    REAL("read", ssize_t, (int, void *, size_t));
+    tally(SyscallAudit::Read);
+    return real(fd, buf, n);
+}
+
+ssize_t pread(int fd, void *buf, size_t n, off_t offset)
+{
+    REAL("pread", ssize_t, (int, void *, size_t, off_t));
+    tally(SyscallAudit::Read);
+    return real(fd, buf, n, offset);
+}
+
+ssize_t __read_chk(int fd, void *buf, size_t n, size_t buflen)
+{
+    REAL("__read_chk", ssize_t, (int, void *, size_t, size_t));
+    tally(SyscallAudit::Read);
+    return real(fd, buf, n, buflen);
+}
+
+ssize_t __pread_chk(int fd, void *buf, size_t n, off_t offset, size_t buflen)
+{
+    REAL("__pread_chk", ssize_t, (int, void *, size_t, off_t, size_t));
+    tally(SyscallAudit::Read);
+    return real(fd, buf, n, offset, buflen);
+}
+
+ssize_t write(int fd, const void *buf, size_t n)
+{
+    REAL("write", ssize_t, (int, const void *, size_t));
+    tally(SyscallAudit::Write);
+    return real(fd, buf, n);
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t n, off_t offset)
+{
+    REAL("pwrite", ssize_t, (int, const void *, size_t, off_t));
+    tally(SyscallAudit::Write);
+    return real(fd, buf, n, offset);
+}
+
+int close(int fd)
+{
+    REAL("close", int, (int));
+    tally(SyscallAudit::Close);
+    return real(fd);
+}
+
+int fclose(void *f)
+{
+    REAL("fclose", int, (void *));
+    tally(SyscallAudit::Close);
+    return real(f);
+}
+
+off_t lseek(int fd, off_t offset, int whence)
+{
+    REAL("lseek", off_t, (int, off_t, int));
+    tally(SyscallAudit::Seek);
+    return real(fd, offset, whence);
+}
+
+int access(const char *path, int mode)
+{
+    REAL("access", int, (const char *, int));
+    tally(SyscallAudit::Stat);
+    return real(path, mode);
+}
+
+int fsync(int fd)
+{
+    REAL("fsync", int, (int));
+    tally(SyscallAudit::Sync);
+    return real(fd);
+}
+
+int fflush(void *f)
+{
+    REAL("fflush", int, (void *));
+    tally(SyscallAudit::Stdio);
+    return real(f);
+}
+
+size_t fread(void *buf, size_t size, size_t n, void *f)
+{
+    REAL("fread", size_t, (void *, size_t, size_t, void *));
+    tally(SyscallAudit::Stdio);
+    return real(buf, size, n, f);
+}
+
+size_t __fread_chk(void *buf, size_t buflen, size_t size, size_t n, void *f)
+{
+    REAL("__fread_chk", size_t, (void *, size_t, size_t, size_t, void *));
+    tally(SyscallAudit::Stdio);
+    return real(buf, buflen, size, n, f);
+}
+
+size_t fwrite(const void *buf, size_t size, size_t n, void *f)
+{
+    REAL("fwrite", size_t, (const void *, size_t, size_t, void *));
+    tally(SyscallAudit::Stdio);
+    return real(buf, size, n, f);
+}
+
+int socket(int domain, int type, int protocol)
+{
+    REAL("socket", int, (int, int, int));
+    tally(SyscallAudit::Socket);
+    return real(domain, type, protocol);
+}
+
+int connect(int fd, const void *addr, unsigned int len)
+{
+    REAL("connect", int, (int, const void *, unsigned int));
+    tally(SyscallAudit::Socket);
+    return real(fd, addr, len);
+}
+
+ssize_t send(int fd, const void *buf, size_t n, int flags)
+{
+    REAL("send", ssize_t, (int, const void *, size_t, int));
+    tally(SyscallAudit::Socket);
+    return real(fd, buf, n, flags);
+}
+
+ssize_t recv(int fd, void *buf, size_t n, int flags)
+{
+    REAL("recv", ssize_t, (int, void *, size_t, int));
+    tally(SyscallAudit::Socket);
+    return real(fd, buf, n, flags);
+}
+
+int nanosleep(const void *req, void *rem)
+{
+    REAL("nanosleep", int, (const void *, void *));
+    tally(SyscallAudit::Sleep);
+    return real(req, rem);
+}
+
+int clock_nanosleep(int clock, int flags, const void *req, void *rem)
+{
+    REAL("clock_nanosleep", int, (int, int, const void *, void *));
+    tally(SyscallAudit::Sleep);
+    return real(clock, flags, req, rem);
+}
+
+int usleep(unsigned int usec)
+{
+    REAL("usleep", int, (unsigned int));
+    tally(SyscallAudit::Sleep);
+    return real(usec);
+}
+
+unsigned int sleep(unsigned int sec)
+{
+    REAL("sleep", unsigned int, (unsigned int));
+    tally(SyscallAudit::Sleep);
+    return real(sec);
+}
+
+int sched_yield()
+{
+    REAL("sched_yield", int, ());
+    tally(SyscallAudit::Sleep);
+    return real();
+}
+
+// Each of these may wait on a futex. A mutex lock only does so if the
+// mutex is already held, so we try it first and count only a lock that
+// finds it busy
+
+int pthread_mutex_lock(void *mutex)
+{
+    REAL("pthread_mutex_lock", int, (void *));
+    if (active()) {
+        typedef int (*TryFn)(void *);
+        static const TryFn tryLock =
+            (TryFn)dlsym(RTLD_NEXT, "pthread_mutex_trylock");
+        int rv = tryLock(mutex);
+        if (rv != EBUSY) return rv;
+        tally(SyscallAudit::LockWait);
+    }
+    return real(mutex);
+}
+
+int pthread_cond_wait(void *cond, void *mutex)
+{
+    REAL("pthread_cond_wait", int, (void *, void *));
+    tally(SyscallAudit::CondWait);
+    return real(cond, mutex);
+}
+
+int pthread_cond_timedwait(void *cond, void *mutex, const void *abstime)
+{
+    REAL("pthread_cond_timedwait", int, (void *, void *, const void *));
+    tally(SyscallAudit::CondWait);
+    return real(cond, mutex, abstime);
+}
+
+int pthread_join(unsigned long thread, void **result)
+{
+    REAL("pthread_join", int, (unsigned long, void **));
+    tally(SyscallAudit::Join);
+    return real(thread, result);
+}
+
+int sem_wait(void *sem)
+{
+    REAL("sem_wait", int, (void *));
+    tally(SyscallAudit::SemWait);
+    return real(sem);
+}
+
+int sem_timedwait(void *sem, const void *abstime)
+{
+    REAL("sem_timedwait", int, (void *, const void *));
+    tally(SyscallAudit::SemWait);
+    return real(sem, abstime);
+}
+
+}
+
+bool
+SyscallAudit::available()
+{
+    // Plugins only reach our definitions if the executable exports
+    // them, in which case a global lookup finds ours first
+    return dlsym(RTLD_DEFAULT, "read") == (void *)&read;
+}
+
+void
+SyscallAudit::begin()
+{
+    for (int i = 0; i < Calls; ++i) counts[i] = 0;
+    counting = true;
+    ++auditing;
+}
+
+void
+SyscallAudit::end()
+{
+    counting = false;
+    --auditing;
+}
+
+int
+SyscallAudit::count(Call c)
+{
+    return counts[c];
+}
+
+#else
+
+bool SyscallAudit::available() { return false; }
+void SyscallAudit::begin() { }
+void SyscallAudit::end() { }
+int SyscallAudit::count(Call) { return 0; }
+
+#endif
+
+const char *
+SyscallAudit::name(Call c)
+{
+    switch (c) {
+    case Open: return "open";
+    case Read: return "read";
+    case Write: return "write";
+    case Close: return "close";
+    case Seek: return "seek";
+    case Stat: return "access";
+    case Sync: return "fsync";
+    case Stdio: return "stdio";
+    case Socket: return "socket";
+    case Sleep: return "sleep/yield";
+    case LockWait: return "contended lock";
+    case CondWait: return "condition wait";
+    case SemWait: return "semaphore wait";
+    case Join: return "thread join";
+    case Calls: break;
+    }
+    return "";
+}
+
+bool
+SyscallAudit::isIO(Call c)
+{
+    return c < Sleep;
+}
+
+bool
+SyscallAudit::isWait(Call c)
+{
+    return c > Sleep && c < Calls;
+}
@@ -0,0 +1,89 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp Plugin Tester
+    Chris Cannam, cannam@all-day-breakfast.com
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2009-2014 QMUL.
+
+    This program loads a Vamp plugin and tests its susceptibility to a
+    number of common pitfalls, including handling of extremes of input
+    data.  If you can think of any additional useful tests that are
+    easily added, please send them to me.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+#ifndef _SYSCALL_AUDIT_H_
+#define _SYSCALL_AUDIT_H_
+
+/**
+ * Counts calls made by the current thread to C library functions
+ * that enter the kernel, such as open, read, write and nanosleep,
+ * between begin() and end().
+ *
+ * This works by defining those functions in the tester executable,
+ * whose exported symbols take precedence over the C library's when
+ * plugin libraries are bound (the Makefile exports them, and only
+ * them, with the dynamic list in SyscallAudit.list). Each counts the
+ * call if counting is enabled for the calling thread, and then
+ * forwards to the real C library function. While no thread is
+ * counting, they forward without looking at any thread-local state. The checked variants such as __read_chk, which
+ * code built with _FORTIFY_SOURCE calls instead, are covered too.
+ * Waits for other threads are counted by type, with a mutex lock
+ * counted only when the mutex is already held. Calls that the C
+ * library makes internally (for example the writes done by stdio) are
+ * not seen. Only available on Linux: elsewhere available() returns
+ * false.
+ */
+class SyscallAudit
+{
+public:
+    // I/O calls come first, then sleeps, then the calls that wait
+    // for another thread
+    enum Call {
+        Open, Read, Write, Close, Seek, Stat, Sync, Stdio, Socket,
+        Sleep,
+        LockWait, CondWait, SemWait, Join,
+        Calls
+    };
+
+    static bool available();
+    static const char *name(Call);
+
+    // are calls of this type blocking I/O?
+    static bool isIO(Call);
+
+    // are calls of this type waits for another thread?
+    static bool isWait(Call);
+
+    static void begin();
+    static void end();
+    static int count(Call);
+};
+
+#endif
@@ -46,6 +46,30 @@ using namespace Vamp::HostExt;
 
 #include <math.h>
 
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <malloc/malloc.h>
+#include <sys/sysctl.h>
+#include <time.h>
+#else
+#include <unistd.h>
+#include <malloc.h>
+#include <cstdio>
+#include <dirent.h>
+#include <time.h>
+#endif
+
 #ifdef __SUNPRO_CC
 #include <ieeefp.h>
 #define isinf(x) (!finite(x))
@@ -54,16 +78,20 @@ using namespace Vamp::HostExt;
 Test::Test() { }
 Test::~Test() { }
 
+int Test::m_threadCount = 0;
+double Test::m_soakDuration = 60.0;
+long long Test::m_stackLimit = 256 * 1024;
+
 using std::cerr;
 using std::cout;
 using std::endl;
 using std::string;
 
 Plugin *
-Test::load(string key, float rate)
+Test::load(string key, float rate, int adapterFlags)
 {
     Plugin *p = PluginLoader::getInstance()->loadPlugin
-        (key, rate, PluginLoader::ADAPT_ALL);
+        (key, rate, adapterFlags);
     if (!p) throw FailedToLoadPlugin();
     return p;
 }
@@ -93,18 +121,33 @@ Test::createTestAudio(size_t channels, size_t blocksize, size_t blocks)
     float **b = new float *[channels];
     for (size_t c = 0; c < channels; ++c) {
         b[c] = new float[blocksize * blocks];
-        for (int i = 0; i < int(blocksize * blocks); ++i) {
-            b[c][i] = sinf(float(i) / 10.f);
-            if (i == 5005 || i == 20002) {
-                b[c][i-2] = 0;
-                b[c][i-1] = -1;
-                b[c][i] = 1;
-            }
+        for (size_t i = 0; i < blocksize * blocks; ++i) {
+            b[c][i] = testSample(i);
         }
     }
     return b;
 }
 
+float
+Test::testSample(size_t i, size_t clickInterval)
+{
+    size_t s = (clickInterval > 0 ? i % clickInterval : i);
+    bool second = (clickInterval == 0);
+    if (s == 5003 || (second && s == 20000)) return 0.f;
+    if (s == 5004 || (second && s == 20001)) return -1.f;
+    if (s == 5005 || (second && s == 20002)) return 1.f;
+    return testTone(i);
+}
+
+float
+Test::testTone(size_t i)
+{
+    // reduce the phase in double precision so that the signal stays
+    // accurate however far into a long input we are
+    const double twoPi = 6.283185307179586;
+    return float(sin(fmod(double(i) / 10.0, twoPi)));
+}
+
 void
 Test::destroyTestAudio(float **b, size_t channels)
 {
@@ -114,6 +157,301 @@ Test::destroyTestAudio(float **b, size_t channels)
     delete[] b;
 }
 
+int
+Test::threadCount()
+{
+    if (m_threadCount > 0) return m_threadCount;
+    int n = std::thread::hardware_concurrency();
+    if (n < 1) n = 1;
+    return n;
+}
+
+void
+Test::setThreadCount(int n)
+{
+    m_threadCount = n;
+}
+
+int
+Test::physicalCores()
+{
+#ifdef _WIN32
+    DWORD length = 0;
+    GetLogicalProcessorInformation(0, &length);
+    if (length == 0) return -1;
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info
+        (length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (!GetLogicalProcessorInformation(&info[0], &length)) return -1;
+    int cores = 0;
+    for (size_t i = 0; i < info.size(); ++i) {
+        if (info[i].Relationship == RelationProcessorCore) ++cores;
+    }
+    return cores > 0 ? cores : -1;
+#elif defined(__APPLE__)
+    int cores = 0;
+    size_t size = sizeof(cores);
+    if (sysctlbyname("hw.physicalcpu", &cores, &size, 0, 0) != 0) return -1;
+    return cores > 0 ? cores : -1;
+#else
+    // Each physical core is identified by its list of hardware
+    // thread siblings, which is the same for every logical CPU on it
+    std::set<std::string> cores;
+    int n = std::thread::hardware_concurrency();
+    for (int i = 0; i < n; ++i) {
+        char path[100];
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list",
+                 i);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        char line[256];
+        if (fgets(line, sizeof(line), f)) cores.insert(line);
+        fclose(f);
+    }
+    return cores.empty() ? -1 : int(cores.size());
+#endif
+}
+
+double
+Test::soakDuration()
+{
+    return m_soakDuration;
+}
+
+void
+Test::setSoakDuration(double seconds)
+{
+    m_soakDuration = seconds;
+}
+
+long long
+Test::stackLimit()
+{
+    return m_stackLimit;
+}
+
+void
+Test::setStackLimit(long long bytes)
+{
+    m_stackLimit = bytes;
+}
+
+long long
+Test::nanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+string
+Test::formatDuration(long long ns)
+{
+    std::ostringstream os;
+    os.setf(std::ios::fixed);
+    os.precision(1);
+    if (ns < 10000LL) os << ns << "ns";
+    else if (ns < 10000000LL) os << double(ns) / 1e3 << "us";
+    else if (ns < 10000000000LL) os << double(ns) / 1e6 << "ms";
+    else os << double(ns) / 1e9 << "s";
+    return os.str();
+}
+
+long long
+Test::median(std::vector<long long> v)
+{
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+void
+Test::linearFit(const std::vector<double> &xs, const std::vector<double> &ys,
+                double &a, double &b)
+{
+    double mx = 0, my = 0;
+    for (size_t i = 0; i < xs.size(); ++i) {
+        mx += xs[i];
+        my += ys[i];
+    }
+    mx /= xs.size();
+    my /= ys.size();
+    double sxy = 0, sxx = 0;
+    for (size_t i = 0; i < xs.size(); ++i) {
+        sxy += (xs[i] - mx) * (ys[i] - my);
+        sxx += (xs[i] - mx) * (xs[i] - mx);
+    }
+    b = (sxx > 0 ? sxy / sxx : 0);
+    a = my - b * mx;
+}
+
+double
+Test::growthExponent(const std::vector<double> &xs,
+                     const std::vector<double> &ys)
+{
+    std::vector<double> lx, ly;
+    for (size_t i = 0; i < xs.size(); ++i) {
+        lx.push_back(log(xs[i]));
+        ly.push_back(log(ys[i]));
+    }
+    double a = 0, b = 0;
+    linearFit(lx, ly, a, b);
+    return b;
+}
+
+long long
+Test::residentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return -1;
+    }
+    return pmc.WorkingSetSize;
+#elif defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                  (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return -1;
+    }
+    return info.resident_size;
+#else
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return -1;
+    long long size = 0, resident = 0;
+    int n = fscanf(f, "%lld %lld", &size, &resident);
+    fclose(f);
+    if (n != 2) return -1;
+    return resident * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+long long
+Test::heapBytes()
+{
+#if defined(__APPLE__)
+    malloc_statistics_t stats;
+    malloc_zone_statistics(0, &stats);
+    return stats.size_in_use;
+#elif defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 mi = mallinfo2();
+#else
+    struct mallinfo mi = mallinfo();
+#endif
+    return (long long)mi.uordblks + (long long)mi.hblkhd;
+#else
+    return -1;
+#endif
+}
+
+int
+Test::processThreads()
+{
+#ifdef _WIN32
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) return -1;
+    DWORD pid = GetCurrentProcessId();
+    THREADENTRY32 te;
+    te.dwSize = sizeof(te);
+    int n = 0;
+    if (Thread32First(snapshot, &te)) {
+        do {
+            if (te.th32OwnerProcessID == pid) ++n;
+        } while (Thread32Next(snapshot, &te));
+    }
+    CloseHandle(snapshot);
+    return n;
+#elif defined(__APPLE__)
+    thread_act_array_t threads;
+    mach_msg_type_number_t count = 0;
+    if (task_threads(mach_task_self(), &threads, &count) != KERN_SUCCESS) {
+        return -1;
+    }
+    for (mach_msg_type_number_t i = 0; i < count; ++i) {
+        mach_port_deallocate(mach_task_self(), threads[i]);
+    }
+    vm_deallocate(mach_task_self(), (vm_address_t)threads,
+                  count * sizeof(thread_act_t));
+    return int(count);
+#else
+    DIR *d = opendir("/proc/self/task");
+    if (!d) return -1;
+    int n = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != 0) {
+        if (e->d_name[0] != '.') ++n;
+    }
+    closedir(d);
+    return n;
+#endif
+}
+
+#ifdef _WIN32
+static long long
+fileTimeNs(const FILETIME &kernel, const FILETIME &user)
+{
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (long long)(k.QuadPart + u.QuadPart) * 100;
+}
+#else
+static long long
+clockNs(clockid_t id)
+{
+    struct timespec ts;
+    if (clock_gettime(id, &ts) != 0) return -1;
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+#endif
+
+long long
+Test::processCpuTime()
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited,
+                         &kernel, &user)) {
+        return -1;
+    }
+    return fileTimeNs(kernel, user);
+#else
+    return clockNs(CLOCK_PROCESS_CPUTIME_ID);
+#endif
+}
+
+long long
+Test::threadCpuTime()
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited,
+                        &kernel, &user)) {
+        return -1;
+    }
+    return fileTimeNs(kernel, user);
+#else
+    return clockNs(CLOCK_THREAD_CPUTIME_ID);
+#endif
+}
+
+string
+Test::formatBytes(long long bytes)
+{
+    if (bytes < 0) return "(unknown)";
+    std::ostringstream os;
+    os.setf(std::ios::fixed);
+    os.precision(1);
+    if (bytes < 10240LL) os << bytes << "B";
+    else if (bytes < 10485760LL) os << double(bytes) / 1024 << "KB";
+    else if (bytes < 10737418240LL) os << double(bytes) / 1048576 << "MB";
+    else os << double(bytes) / 1073741824 << "GB";
+    return os.str();
+}
+
 bool
 Test::initDefaults(Plugin *p, size_t &channels, size_t &step, size_t &block,
                    Results &r)
@@ -145,6 +483,30 @@ Test::initAdapted(Plugin *p, size_t &channels, size_t step, size_t block,
     return true;
 }
 
+void
+Test::timeRun(Plugin *p, float **audio, size_t channels,
+              size_t step, size_t count, int rate,
+              long long &processTime, long long &remainingTime,
+              Plugin::FeatureSet *f)
+{
+    processTime = 0;
+    float **ptr = new float *[channels];
+    for (size_t i = 0; i < count; ++i) {
+        size_t idx = i * step;
+        for (size_t c = 0; c < channels; ++c) ptr[c] = audio[c] + idx;
+        RealTime timestamp = RealTime::frame2RealTime(idx, rate);
+        long long start = nanoseconds();
+        Plugin::FeatureSet fs = p->process(ptr, timestamp);
+        processTime += nanoseconds() - start;
+        if (f) appendFeatures(*f, fs);
+    }
+    delete[] ptr;
+    long long start = nanoseconds();
+    Plugin::FeatureSet fs = p->getRemainingFeatures();
+    remainingTime = nanoseconds() - start;
+    if (f) appendFeatures(*f, fs);
+}
+
 void
 Test::appendFeatures(Plugin::FeatureSet &a, const Plugin::FeatureSet &b)
 {
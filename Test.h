@@ -43,6 +43,7 @@
 #include <string>
 
 #include <vamp-hostsdk/Plugin.h>
+#include <vamp-hostsdk/PluginLoader.h>
 
 class Test
 {
@@ -53,7 +54,8 @@ public:
         NoOption           = 0x0,
         NonDeterministic   = 0x1,
         Verbose            = 0x2,
-        SingleTest         = 0x4
+        SingleTest         = 0x4,
+        Benchmarks         = 0x8
     };
     typedef int Options;
     
@@ -82,14 +84,51 @@ public:
 
     class FailedToLoadPlugin { };
 
+    // Number of threads used by tests that run several plugin
+    // instances concurrently. Defaults to the hardware concurrency
+    static int threadCount();
+    static void setThreadCount(int);
+
+    // Number of physical processor cores, not counting simultaneous
+    // multithreading siblings, or -1 if the platform gives us no way
+    // to find out
+    static int physicalCores();
+
+    // Duration in seconds of the input audio for the soak test.
+    // Defaults to one minute, unless set with --soak
+    static double soakDuration();
+    static void setSoakDuration(double);
+
+    // Greatest stack depth in bytes that a plugin may use in
+    // initialise or process. Defaults to 256KB
+    static long long stackLimit();
+    static void setStackLimit(long long);
+
+    // monotonic clock, nanoseconds since some arbitrary origin:
+    static long long nanoseconds();
+
+    // sample i of the test signal of createTestAudio, a sine with two
+    // clicks. If clickInterval is nonzero, the click is instead
+    // repeated every clickInterval samples, for long streamed inputs:
+    static float testSample(size_t i, size_t clickInterval = 0);
+
+    // sample i of the same sine, without the clicks:
+    static float testTone(size_t i);
+
     // may throw FailedToLoadPlugin
     virtual Results test(std::string key, Options) = 0;
 
 protected:
     Test();
 
+    static int m_threadCount;
+    static double m_soakDuration;
+    static long long m_stackLimit;
+
     // may throw FailedToLoadPlugin
-    Vamp::Plugin *load(std::string key, float rate = 44100);
+    Vamp::Plugin *load(std::string key, float rate = 44100,
+                       int adapterFlags =
+                       Vamp::HostExt::PluginLoader::ADAPT_ALL);
 
     float **createBlock(size_t channels, size_t blocksize);
     void destroyBlock(float **blocks, size_t channels);
@@ -97,6 +136,38 @@ protected:
     float **createTestAudio(size_t channels, size_t blocksize, size_t blocks);
     void destroyTestAudio(float **audio, size_t channels);
 
+    // e.g. "12.3ms", "456us":
+    static std::string formatDuration(long long ns);
+
+    static long long median(std::vector<long long>);
+
+    // least-squares fit of y = a + b * x, returning a and b:
+    static void linearFit(const std::vector<double> &xs,
+                          const std::vector<double> &ys,
+                          double &a, double &b);
+
+    // least-squares slope of log(y) against log(x), i.e. the exponent
+    // k in a fit of y = a * x^k:
+    static double growthExponent(const std::vector<double> &xs,
+                                 const std::vector<double> &ys);
+
+    // memory in use by the whole process, in bytes, or -1 if the
+    // platform gives us no way to find out:
+    static long long residentBytes();
+    static long long heapBytes();
+
+    // e.g. "1.5MB":
+    static std::string formatBytes(long long bytes);
+
+    // number of threads in the whole process, or -1 if the platform
+    // gives us no way to find out:
+    static int processThreads();
+
+    // CPU time consumed so far by the whole process and by the
+    // calling thread, in nanoseconds, or -1 if unknown:
+    static long long processCpuTime();
+    static long long threadCpuTime();
+
     // use plugin's preferred step/block size, return them:
     bool initDefaults(Vamp::Plugin *, size_t &channels,
                       size_t &step, size_t &block, Results &r);
@@ -105,6 +176,15 @@ protected:
     bool initAdapted(Vamp::Plugin *, size_t &channels,
                      size_t step, size_t block, Results &r);
 
+    // run an initialised plugin over count steps of the given audio,
+    // returning the time spent in process calls and in the final
+    // getRemainingFeatures call; features are appended to f if it
+    // is non-null, otherwise discarded:
+    void timeRun(Vamp::Plugin *, float **audio, size_t channels,
+                 size_t step, size_t count, int rate,
+                 long long &processTime, long long &remainingTime,
+                 Vamp::Plugin::FeatureSet *f = 0);
+
     void appendFeatures(Vamp::Plugin::FeatureSet &a,
                         const Vamp::Plugin::FeatureSet &b);
 
@@ -43,6 +43,8 @@
 using namespace Vamp;
 
 #include <memory>
+#include <iostream>
+#include <iomanip>
 using namespace std;
 
 #include <cmath>
@@ -57,6 +59,9 @@ TestDefaultParameters::m_registrar("E2", "Inconsistent default parameters");
 Tester::TestRegistrar<TestParametersOnReset>
 TestParametersOnReset::m_registrar("E3", "Parameter retention through reset");
 
+Tester::TestRegistrar<TestProgramSwitching>
+TestProgramSwitching::m_registrar("E4", "Program switching");
+
 static const size_t _step = 1000;
 
 Test::Results
@@ -272,3 +277,96 @@ TestParametersOnReset::test(string key, Options options)
 
     return r;
 }
+
+Test::Results
+TestProgramSwitching::test(string key, Options options)
+{
+    int rate = 44100;
+    Results r;
+    float **data = 0;
+    size_t channels = 0;
+    size_t count = 100;
+
+    // Time taken by selectProgram above which we warn, in seconds
+    const double slow = 0.1;
+
+    vector<string> programs;
+    {
+        unique_ptr<Plugin> p(load(key, rate));
+        programs = p->getPrograms();
+    }
+    if (programs.empty()) return r;
+
+    // Time the selection of each program on a fresh instance, and the
+    // initialise call that follows it
+
+    if (options & Verbose) {
+        cout << "    " << left << setw(24) << "Program" << setw(16)
+             << "selectProgram" << "initialise" << endl;
+    }
+
+    for (int i = 0; i < (int)programs.size(); ++i) {
+        unique_ptr<Plugin> p(load(key, rate));
+        long long start = nanoseconds();
+        p->selectProgram(programs[i]);
+        long long selectTime = nanoseconds() - start;
+        start = nanoseconds();
+        bool ok = initAdapted(p.get(), channels, _step, _step, r);
+        long long initTime = nanoseconds() - start;
+        if (!ok) return r;
+        if (options & Verbose) {
+            cout << "    " << setw(24) << programs[i] << setw(16)
+                 << formatDuration(selectTime) << formatDuration(initTime)
+                 << endl;
+        }
+        if (selectTime > slow * 1e9) {
+            r.push_back(warning("Selecting program \"" + programs[i] + "\" takes " + formatDuration(selectTime)));
+        }
+    }
+
+    if (options & Verbose) cout << right;
+
+    if (programs.size() < 2) return r;
+
+    // Run once having selected program A, and once having selected A,
+    // then B, then A again, as a host reusing an instance would
+
+    Plugin::FeatureSet f[2];
+    string a = programs[0], b = programs[1];
+
+    for (int run = 0; run < 2; ++run) {
+        unique_ptr<Plugin> p(load(key, rate));
+        p->selectProgram(a);
+        if (run == 1) {
+            p->selectProgram(b);
+            p->selectProgram(a);
+        }
+        if (!initAdapted(p.get(), channels, _step, _step, r)) return r;
+        if (!data) data = createTestAudio(channels, _step, count);
+        for (size_t i = 0; i < count; ++i) {
+            float **ptr = new float *[channels];
+            size_t idx = i * _step;
+            for (size_t c = 0; c < channels; ++c) ptr[c] = data[c] + idx;
+            RealTime timestamp = RealTime::frame2RealTime(idx, rate);
+            Plugin::FeatureSet fs = p->process(ptr, timestamp);
+            delete[] ptr;
+            appendFeatures(f[run], fs);
+        }
+        Plugin::FeatureSet fs = p->getRemainingFeatures();
+        appendFeatures(f[run], fs);
+    }
+    if (data) destroyTestAudio(data, channels);
+
+    if (!(f[0] == f[1])) {
+        string message = "Switching from program \"" + a + "\" to \"" + b + "\" and back changes the results";
+        Result res;
+        if (options & NonDeterministic) res = note(message);
+        else res = error(message);
+        if (options & Verbose) dumpDiff(res, f[0], f[1]);
+        r.push_back(res);
+    } else {
+        r.push_back(success());
+    }
+
+    return r;
+}
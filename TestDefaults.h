@@ -73,4 +73,14 @@ protected:
     static Tester::TestRegistrar<TestParametersOnReset> m_registrar;
 };
 
+class TestProgramSwitching : public Test
+{
+public:
+    TestProgramSwitching() : Test() { }
+    Results test(std::string key, Options options);
+    
+protected:
+    static Tester::TestRegistrar<TestProgramSwitching> m_registrar;
+};
+
 #endif
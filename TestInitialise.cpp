@@ -41,15 +41,33 @@
 
 #include <vamp-hostsdk/Plugin.h>
 #include <vamp-hostsdk/PluginLoader.h>
+#include <vamp-hostsdk/PluginHostAdapter.h>
+#include <vamp-hostsdk/PluginInputDomainAdapter.h>
+#include <vamp-hostsdk/PluginBufferingAdapter.h>
+#include <vamp-hostsdk/PluginChannelAdapter.h>
 using namespace Vamp;
 using namespace Vamp::HostExt;
 
 #include <set>
 #include <memory>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <stdexcept>
 using namespace std;
 
 #include <cmath>
-#include <ctime>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
 
 Tester::TestRegistrar<TestSampleRates>
 TestSampleRates::m_registrar("F1", "Different sample rates");
@@ -57,81 +75,476 @@ TestSampleRates::m_registrar("F1", "Different sample rates");
 Tester::TestRegistrar<TestLengthyConstructor>
 TestLengthyConstructor::m_registrar("F2", "Lengthy constructor");
 
+Tester::TestRegistrar<TestStartupCost>
+TestStartupCost::m_registrar("F3", "Startup cost breakdown", true);
+
+Tester::TestRegistrar<TestChannelCounts>
+TestChannelCounts::m_registrar("F4", "Different channel counts");
+
 Test::Results
 TestSampleRates::test(string key, Options options)
 {
     int rates[] =
         { 111, 800, 10099, 11024, 44100, 48000, 96000, 192000, 201011, 1094091 };
+    const int n = int(sizeof(rates)/sizeof(rates[0]));
+    const int reference = 44100;
 
-    Results r;
+    // Cost per sample this many times greater than at the reference
+    // rate counts as a dramatic slowdown, provided the plugin spends
+    // at least minimumCost per second of audio (below which fixed
+    // per-call costs dominate at the lowest rates)
+    const double slowdown = 4.0;
+    const long long minimumCost = 1000000;
 
-    if (options & Verbose) {
-        cout << "    ";
-    }
+    // Each rate is timed as the best of this many passes, to smooth
+    // out interference from other activity on the machine
+    const int passes = 3;
 
-    for (int i = 0; i < int(sizeof(rates)/sizeof(rates[0])); ++i) {
-    
-        int rate = rates[i];
+    Results r;
 
-        if (options & Verbose) {
-            cout << "[" << rate << "Hz] " << flush;
-        }
+    // Aim to feed the plugin a roughly fixed input duration in secs
+    const float seconds = 10.f;
+    size_t step = 1000;
 
-        unique_ptr<Plugin> p(load(key, rate));
-        Plugin::FeatureSet f;
-        float **data = 0;
-        size_t channels = 0;
+    // Plugins are loaded and initialised here, and then each rate is
+    // run in turn. With -b, the rates are instead run in separate
+    // threads, up to the configured thread count at a time. Timings
+    // are then only indicative, but a rate at which the plugin is
+    // disproportionately slow should still stand out
 
-        // Aim to feed the plugin a roughly fixed input duration in secs
-        const float seconds = 10.f;
-        size_t step = 1000;
-        size_t count = (seconds * rate) / step;
-        if (count < 1) count = 1;
+    struct Run {
+        unique_ptr<Plugin> plugin;
+        size_t channels;
+        size_t count;
+        bool refused;
+        string exception;
+        long long time;
+        Run() : channels(0), count(0), refused(false), time(0) { }
+    };
+    vector<Run> runs(n);
 
+    for (int i = 0; i < n; ++i) {
+        int rate = rates[i];
+        runs[i].plugin.reset(load(key, rate));
+        runs[i].count = size_t((seconds * rate) / step);
+        if (runs[i].count < 1) runs[i].count = 1;
         Results subr;
-        if (!initAdapted(p.get(), channels, step, step, subr)) {
+        if (!initAdapted(runs[i].plugin.get(), runs[i].channels,
+                         step, step, subr)) {
             // This is not an error; the plugin can legitimately
             // refuse to initialise at weird settings and that's often
             // the most acceptable result
-            if (!subr.empty()) {
-                r.push_back(note(subr.begin()->message()));
-            }
-            continue;
+            runs[i].refused = true;
+            runs[i].plugin.reset();
         }
+    }
 
-        data = createTestAudio(channels, step, count);
-        for (size_t j = 0; j < count; ++j) {
-            float **ptr = new float *[channels];
-            size_t idx = j * step;
-            for (size_t c = 0; c < channels; ++c) ptr[c] = data[c] + idx;
-            RealTime timestamp = RealTime::frame2RealTime(idx, rate);
-            Plugin::FeatureSet fs = p->process(ptr, timestamp);
-            delete[] ptr;
-            appendFeatures(f, fs);
+    mutex outputMutex;
+    atomic<int> next(0);
+
+    if (options & Verbose) {
+        cout << "    ";
+    }
+
+    auto worker = [&]() {
+        while (true) {
+            int i = next++;
+            if (i >= n) return;
+            Run &run = runs[i];
+            if (run.refused) continue;
+            int rate = rates[i];
+            if (options & Verbose) {
+                lock_guard<mutex> guard(outputMutex);
+                cout << "[" << rate << "Hz] " << flush;
+            }
+            float **block = createBlock(run.channels, step);
+            try {
+                for (int pass = 0; pass < passes; ++pass) {
+                    if (pass > 0) run.plugin->reset();
+                    long long time = 0;
+                    for (size_t j = 0; j < run.count; ++j) {
+                        size_t idx = j * step;
+                        for (size_t k = 0; k < step; ++k) {
+                            float v = testSample(idx + k);
+                            for (size_t c = 0; c < run.channels; ++c) {
+                                block[c][k] = v;
+                            }
+                        }
+                        RealTime timestamp =
+                            RealTime::frame2RealTime(idx, rate);
+                        long long start = nanoseconds();
+                        run.plugin->process(block, timestamp);
+                        time += nanoseconds() - start;
+                    }
+                    long long start = nanoseconds();
+                    run.plugin->getRemainingFeatures();
+                    time += nanoseconds() - start;
+                    if (pass == 0 || time < run.time) run.time = time;
+                }
+            } catch (const std::exception &e) {
+                run.exception = e.what();
+            } catch (...) {
+                run.exception = "unknown exception";
+            }
+            destroyBlock(block, run.channels);
         }
-        Plugin::FeatureSet fs = p->getRemainingFeatures();
-        appendFeatures(f, fs);
-        destroyTestAudio(data, channels);
+    };
+
+    if (options & Benchmarks) {
+        int threads = min(threadCount(), n);
+        vector<thread> pool;
+        for (int t = 0; t < threads; ++t) pool.push_back(thread(worker));
+        for (int t = 0; t < threads; ++t) pool[t].join();
+    } else {
+        worker();
     }
 
     if (options & Verbose) cout << endl;
 
-    // We can't actually do anything meaningful with our results.
-    // We're really just testing to see whether the plugin crashes.  I
-    // wonder whether it's possible to do any better?  If not, we
-    // should probably report our limitations
+    // Cost in ns per second of audio at each rate
+    vector<double> costs(n, -1.0);
+    double referenceCost = -1.0;
+    for (int i = 0; i < n; ++i) {
+        if (runs[i].refused || !runs[i].exception.empty()) continue;
+        costs[i] = runs[i].time / (double(runs[i].count * step) / rates[i]);
+        if (rates[i] == reference) referenceCost = costs[i];
+    }
+
+    if (options & Verbose) {
+        cout << "    " << left << setw(12) << "Rate" << setw(20)
+             << "Cost per second" << "Real-time factor" << endl;
+        for (int i = 0; i < n; ++i) {
+            cout << "    " << setw(12) << (to_string(rates[i]) + "Hz");
+            if (runs[i].refused) {
+                cout << "refused" << endl;
+            } else if (costs[i] < 0) {
+                cout << "failed" << endl;
+            } else {
+                ostringstream os;
+                os << fixed << setprecision(1)
+                   << (costs[i] > 0 ? 1e9 / costs[i] : 0.0) << "x";
+                cout << setw(20) << formatDuration((long long)costs[i])
+                     << os.str() << endl;
+            }
+        }
+        cout << right;
+    }
+
+    string refused;
+    for (int i = 0; i < n; ++i) {
+        if (!runs[i].refused) continue;
+        if (refused != "") refused += ", ";
+        refused += to_string(rates[i]) + "Hz";
+    }
+    if (refused != "") {
+        r.push_back(note("Plugin refused to initialise at sample rate(s) " + refused));
+    }
+
+    for (int i = 0; i < n; ++i) {
+        if (!runs[i].exception.empty()) {
+            r.push_back(error("Plugin threw an exception at " + to_string(rates[i]) + "Hz: " + runs[i].exception));
+        }
+    }
+
+    if (referenceCost > 0) {
+        for (int i = 0; i < n; ++i) {
+            if (costs[i] < minimumCost) continue;
+            double expected = referenceCost * rates[i] / reference;
+            if (costs[i] > expected * slowdown) {
+                ostringstream os;
+                os << fixed << setprecision(1) << costs[i] / expected;
+                r.push_back(note("Plugin is disproportionately slow at " + to_string(rates[i]) + "Hz: " + os.str() + " times the cost per sample at " + to_string(reference) + "Hz"));
+            }
+        }
+    }
+
+    // A plugin that crashes outright takes the tester down with it;
+    // with -v, the rates printed above show which were in progress
 
     return r;
 }
 
 Test::Results
-TestLengthyConstructor::test(string key, Options)
+TestLengthyConstructor::test(string key, Options options)
 {
-    time_t t0 = time(0);
+    long long t0 = nanoseconds();
     unique_ptr<Plugin> p(load(key));
-    time_t t1 = time(0);
+    long long t1 = nanoseconds();
     Results r;
-    if (t1 - t0 > 1) r.push_back(warning("Constructor takes some time to run: work should be deferred to initialise?"));
+    if (options & Verbose) {
+        cout << "    Load and construct: " << formatDuration(t1 - t0) << endl;
+    }
+    if (t1 - t0 > 1000000000LL) r.push_back(warning("Constructor takes some time to run: work should be deferred to initialise?"));
     return r;
 }
 
+// Library handling as in the host SDK's PluginLoader, repeated here
+// so that each stage of loading can be timed separately
+
+static void *
+openLibrary(string path, bool &wasResident)
+{
+#ifdef _WIN32
+    wasResident = (GetModuleHandleA(path.c_str()) != 0);
+    return (void *)LoadLibraryA(path.c_str());
+#else
+    void *h = dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL | RTLD_NOLOAD);
+    wasResident = (h != 0);
+    if (h) dlclose(h);
+    return dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL);
+#endif
+}
+
+static void *
+lookupSymbol(void *handle, const char *symbol)
+{
+#ifdef _WIN32
+    return (void *)GetProcAddress((HINSTANCE)handle, symbol);
+#else
+    return dlsym(handle, symbol);
+#endif
+}
+
+static void
+closeLibrary(void *handle)
+{
+#ifdef _WIN32
+    FreeLibrary((HINSTANCE)handle);
+#else
+    dlclose(handle);
+#endif
+}
+
+static const int _startupTrials = 10;
+
+Test::Results
+TestStartupCost::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+
+    string path = PluginLoader::getInstance()->getLibraryPathForPlugin(key);
+    string::size_type ci = key.find(':');
+    if (path == "" || ci == string::npos) throw FailedToLoadPlugin();
+    string id = key.substr(ci + 1);
+
+    enum { Library, Descriptor, Construct, Adapt, Initialise, Process, Phases };
+    const char *names[Phases] = {
+        "Load library", "Find descriptor", "Construct",
+        "Wrap in adapters", "Initialise", "First process"
+    };
+    vector<long long> times[Phases];
+    bool resident = false;
+
+    for (int trial = 0; trial < _startupTrials; ++trial) {
+
+        long long d[Phases];
+
+        // Static initialisers in the library are run from within
+        // the library load, and so are included in its time
+
+        bool wasResident = false;
+        long long start = nanoseconds();
+        void *handle = openLibrary(path, wasResident);
+        d[Library] = nanoseconds() - start;
+        if (!handle) throw FailedToLoadPlugin();
+        if (trial == 0) resident = wasResident;
+
+        start = nanoseconds();
+        VampGetPluginDescriptorFunction fn =
+            (VampGetPluginDescriptorFunction)lookupSymbol
+            (handle, "vampGetPluginDescriptor");
+        const VampPluginDescriptor *descriptor = 0;
+        if (fn) {
+            for (unsigned int i = 0; ; ++i) {
+                const VampPluginDescriptor *desc = fn(VAMP_API_VERSION, i);
+                if (!desc) break;
+                if (id == desc->identifier) {
+                    descriptor = desc;
+                    break;
+                }
+            }
+        }
+        d[Descriptor] = nanoseconds() - start;
+        if (!descriptor) {
+            closeLibrary(handle);
+            throw FailedToLoadPlugin();
+        }
+
+        start = nanoseconds();
+        Plugin *p = new PluginHostAdapter(descriptor, rate);
+        d[Construct] = nanoseconds() - start;
+
+        // The same adapters, in the same order, as PluginLoader
+        // applies for ADAPT_ALL
+        start = nanoseconds();
+        if (p->getInputDomain() == Plugin::FrequencyDomain) {
+            p = new PluginInputDomainAdapter(p);
+        }
+        p = new PluginBufferingAdapter(p);
+        p = new PluginChannelAdapter(p);
+        d[Adapt] = nanoseconds() - start;
+
+        size_t channels, step, block;
+        start = nanoseconds();
+        bool ok = initDefaults(p, channels, step, block, r);
+        d[Initialise] = nanoseconds() - start;
+        if (!ok) {
+            delete p;
+            closeLibrary(handle);
+            return r;
+        }
+
+        float **data = createTestAudio(channels, block, 1);
+        start = nanoseconds();
+        p->process(data, RealTime::zeroTime);
+        d[Process] = nanoseconds() - start;
+
+        destroyTestAudio(data, channels);
+        delete p;
+        closeLibrary(handle);
+
+        for (int i = 0; i < Phases; ++i) {
+            times[i].push_back(d[i]);
+        }
+    }
+
+    long long firstTotal = 0, medianTotal = 0;
+    cout << "    " << setw(18) << left << "Phase"
+         << setw(14) << "First trial"
+         << "Median of " << _startupTrials << endl;
+    for (int i = 0; i < Phases; ++i) {
+        long long m = median(times[i]);
+        cout << "    " << setw(18) << left << names[i]
+             << setw(14) << formatDuration(times[i][0])
+             << formatDuration(m) << endl;
+        firstTotal += times[i][0];
+        medianTotal += m;
+    }
+    cout << "    " << setw(18) << left << "Total"
+         << setw(14) << formatDuration(firstTotal)
+         << formatDuration(medianTotal) << endl;
+    cout << right;
+
+    r.push_back(note("Startup takes " + formatDuration(medianTotal) +
+                     " (median), " + formatDuration(firstTotal) +
+                     " on first load"));
+    if (resident) {
+        r.push_back(note("Plugin library was already loaded before the first trial, so its load time excludes static initialisation"));
+    }
+
+    return r;
+}
+
+Test::Results
+TestChannelCounts::test(string key, Options options)
+{
+    int rate = 44100;
+    Results r;
+    size_t step = 1000;
+    size_t count = 100;
+
+    size_t minChannels, maxChannels;
+    {
+        unique_ptr<Plugin> p(load(key, rate, 0));
+        minChannels = p->getMinChannelCount();
+        maxChannels = p->getMaxChannelCount();
+    }
+
+    // Every count in the plugin's own range (up to a limit), plus
+    // some either side of it that only work because of the channel
+    // adapter: one either side, and the 5.1 and third-order
+    // ambisonic counts of 6 and 16
+
+    const size_t limit = 16;
+    set<size_t> counts;
+    for (size_t c = minChannels; c <= maxChannels && c <= limit; ++c) {
+        counts.insert(c);
+    }
+    if (minChannels > 1) counts.insert(minChannels - 1);
+    if (maxChannels < limit) {
+        counts.insert(maxChannels + 1);
+        if (maxChannels < 6) counts.insert(6);
+        counts.insert(limit);
+    }
+
+    vector<double> xs, ys;
+
+    if (options & Verbose) {
+        cout << "    " << left << setw(10) << "Channels"
+             << "Per sec of audio" << endl;
+    }
+
+    for (set<size_t>::const_iterator ci = counts.begin();
+         ci != counts.end(); ++ci) {
+
+        size_t channels = *ci;
+        bool inRange = (channels >= minChannels && channels <= maxChannels);
+        string desc = to_string(channels) + " channel(s)";
+
+        unique_ptr<Plugin> p(load(key, rate));
+        if (!p->initialise(channels, step, step)) {
+            if (inRange) {
+                r.push_back(error("Initialisation with " + desc + " failed, although this is within the plugin's stated channel range"));
+            } else {
+                r.push_back(note("Initialisation with " + desc + " failed, when adapted from the plugin's stated channel range"));
+            }
+            continue;
+        }
+
+        Plugin::OutputList outputs = p->getOutputDescriptors();
+
+        float **data = createTestAudio(channels, step, count);
+        Plugin::FeatureSet f;
+        long long processTime = 0, remainingTime = 0;
+        timeRun(p.get(), data, channels, step, count, rate,
+                processTime, remainingTime, &f);
+        destroyTestAudio(data, channels);
+
+        double perSecond =
+            (processTime + remainingTime) / (double(count * step) / rate);
+        if (options & Verbose) {
+            cout << "    " << setw(10) << channels
+                 << formatDuration((long long)perSecond)
+                 << (inRange ? "" : " (adapted)") << endl;
+        }
+        if (inRange) {
+            xs.push_back(channels);
+            ys.push_back(perSecond);
+        }
+
+        if (!allFeaturesValid(f)) {
+            r.push_back(warning("Plugin returned one or more NaN/inf values when run with " + desc));
+            if (options & Verbose) dump(f);
+        }
+        for (Plugin::FeatureSet::const_iterator i = f.begin();
+             i != f.end(); ++i) {
+            if (i->first < 0 || i->first >= int(outputs.size())) {
+                r.push_back(error("Data returned on nonexistent output when run with " + desc));
+                continue;
+            }
+            const Plugin::OutputDescriptor &od = outputs[i->first];
+            if (!od.hasFixedBinCount) continue;
+            for (int j = 0; j < int(i->second.size()); ++j) {
+                if (i->second[j].values.size() != od.binCount) {
+                    r.push_back(error("Plugin returns features with a different number of values from the fixed bin count of output \"" + od.identifier + "\" when run with " + desc));
+                    break;
+                }
+            }
+        }
+    }
+
+    if (options & Verbose) {
+        cout << right;
+        if (xs.size() > 1) {
+            double intercept = 0, slope = 0;
+            linearFit(xs, ys, intercept, slope);
+            cout << "    Each added channel costs "
+                 << (slope < 0 ? "-" : "")
+                 << formatDuration((long long)fabs(slope))
+                 << " per second of audio" << endl;
+        }
+    }
+
+    return r;
+}
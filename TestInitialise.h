@@ -63,4 +63,24 @@ protected:
     static Tester::TestRegistrar<TestLengthyConstructor> m_registrar;
 };
 
+class TestStartupCost : public Test
+{
+public:
+    TestStartupCost() : Test() { }
+    Results test(std::string key, Options options);
+    
+protected:
+    static Tester::TestRegistrar<TestStartupCost> m_registrar;
+};
+
+class TestChannelCounts : public Test
+{
+public:
+    TestChannelCounts() : Test() { }
+    Results test(std::string key, Options options);
+    
+protected:
+    static Tester::TestRegistrar<TestChannelCounts> m_registrar;
+};
+
 #endif
@@ -0,0 +1,312 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp Plugin Tester
+    Chris Cannam, cannam@all-day-breakfast.com
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2009-2014 QMUL.
+
+    This program loads a Vamp plugin and tests its susceptibility to a
+    number of common pitfalls, including handling of extremes of input
+    data.  If you can think of any additional useful tests that are
+    easily added, please send them to me.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+#include "TestMemory.h"
+
+#include <vamp-hostsdk/Plugin.h>
+#include <vamp-hostsdk/PluginLoader.h>
+using namespace Vamp;
+using namespace Vamp::HostExt;
+
+#include <memory>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <set>
+using namespace std;
+
+#include <cmath>
+
+Tester::TestRegistrar<TestMemoryScaling>
+TestMemoryScaling::m_registrar("I1", "Memory use by block size and channel count", true);
+
+Tester::TestRegistrar<TestInstanceMemory>
+TestInstanceMemory::m_registrar("I2", "Memory use per additional instance", true);
+
+Test::Results
+TestMemoryScaling::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+    const double seconds = 2.0;
+
+    if (heapBytes() < 0 && residentBytes() < 0) {
+        r.push_back(note("Memory use cannot be measured on this platform"));
+        return r;
+    }
+
+    // Load without a buffering adapter, so that the plugin itself
+    // sees the block sizes we ask for and the adapter's own buffers
+    // are not counted
+    const int flags = PluginLoader::ADAPT_ALL_SAFE;
+
+    size_t minChannels, maxChannels;
+    {
+        unique_ptr<Plugin> p(load(key, rate, 0));
+        minChannels = p->getMinChannelCount();
+        maxChannels = p->getMaxChannelCount();
+    }
+
+    set<size_t> channelCounts;
+    channelCounts.insert(minChannels);
+    if (maxChannels >= 2 && minChannels < 2) channelCounts.insert(2);
+    if (maxChannels >= 6 && minChannels < 6) channelCounts.insert(6);
+
+    cout << "    " << left << setw(8) << "Block" << setw(10) << "Channels"
+         << setw(16) << "Heap after init" << setw(16) << "Peak heap"
+         << setw(16) << "RSS after init" << "RSS after run" << endl;
+
+    bool measured = false;
+
+    for (set<size_t>::const_iterator ci = channelCounts.begin();
+         ci != channelCounts.end(); ++ci) {
+
+        size_t channels = *ci;
+        vector<double> blocks, heaps;
+
+        for (size_t block = 256; block <= 65536; block *= 2) {
+
+            size_t count = size_t(seconds * rate) / block;
+            if (count < 4) count = 4;
+            float **data = createTestAudio(channels, 1, count * block);
+
+            // All deltas are from the state before the instance was
+            // constructed, and so count everything it allocates
+            long long heap0 = heapBytes(), rss0 = residentBytes();
+
+            Plugin *p = load(key, rate, flags);
+            if (!p->initialise(channels, block, block)) {
+                delete p;
+                destroyTestAudio(data, channels);
+                cout << "    " << setw(8) << block << setw(10) << channels
+                     << "(refused by plugin)" << endl;
+                continue;
+            }
+
+            long long initHeap = heapBytes() - heap0;
+            long long initRss = residentBytes() - rss0;
+            long long peakHeap = initHeap;
+
+            float **ptr = new float *[channels];
+            for (size_t i = 0; i <= count; ++i) {
+                if (i < count) {
+                    for (size_t c = 0; c < channels; ++c) {
+                        ptr[c] = data[c] + i * block;
+                    }
+                    p->process(ptr, RealTime::frame2RealTime(i * block, rate));
+                } else {
+                    p->getRemainingFeatures();
+                }
+                long long h = heapBytes() - heap0;
+                if (h > peakHeap) peakHeap = h;
+            }
+            delete[] ptr;
+
+            long long runRss = residentBytes() - rss0;
+
+            delete p;
+            destroyTestAudio(data, channels);
+
+            if (heap0 < 0) initHeap = peakHeap = -1;
+            if (rss0 < 0) initRss = runRss = -1;
+
+            cout << "    " << setw(8) << block << setw(10) << channels
+                 << setw(16) << formatBytes(initHeap)
+                 << setw(16) << formatBytes(peakHeap)
+                 << setw(16) << formatBytes(initRss)
+                 << formatBytes(runRss) << endl;
+
+            measured = true;
+
+            // Fit only where there is enough allocation to measure
+            if (peakHeap > 4096) {
+                blocks.push_back(double(block));
+                heaps.push_back(double(peakHeap));
+            }
+        }
+
+        if (blocks.size() > 2) {
+            double k = growthExponent(blocks, heaps);
+            ostringstream os;
+            os << fixed << setprecision(2) << k;
+            r.push_back(note("With " + to_string(channels) + " channel(s), peak heap use grows as block size to the power " + os.str()));
+            if (k > 1.5) {
+                r.push_back(warning("Memory use grows faster than linearly with block size (power " + os.str() + " with " + to_string(channels) + " channel(s)), so large block sizes may need a great deal of memory"));
+            }
+        }
+    }
+
+    cout << right;
+
+    if (!measured) {
+        r.push_back(warning("Plugin could not be initialised with any of the block sizes tried"));
+    }
+
+    return r;
+}
+
+Test::Results
+TestInstanceMemory::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+    const double seconds = 10.0;
+    const int maxInstances = 16;
+
+    if (heapBytes() < 0 && residentBytes() < 0) {
+        r.push_back(note("Memory use cannot be measured on this platform"));
+        return r;
+    }
+
+    // Every measurement is taken against this baseline from before
+    // the library is first loaded. The holder instance is never
+    // initialised, and keeps the library loaded for the whole test, so
+    // that each measurement includes the shared costs (loading the
+    // library, static tables) exactly once whether or not the platform
+    // would unload the library between instance counts
+
+    long long heap0 = heapBytes(), rss0 = residentBytes();
+    unique_ptr<Plugin> holder(load(key, rate));
+
+    size_t channels = 0, step = 0, block = 0;
+    {
+        unique_ptr<Plugin> p(load(key, rate));
+        if (!initDefaults(p.get(), channels, step, block, r)) return r;
+    }
+    size_t count = size_t(seconds * rate / step);
+    if (count < 1) count = 1;
+
+    // The test audio stays allocated throughout, so take it out of
+    // the baseline
+    long long heapA = heapBytes(), rssA = residentBytes();
+    float **data = createTestAudio(channels, block, count);
+    if (heap0 >= 0) heap0 += heapBytes() - heapA;
+    if (rss0 >= 0) rss0 += residentBytes() - rssA;
+
+    // For each instance count, all instances are created from nothing
+    // and deleted again afterwards
+
+    enum { InitHeap, InitRss, RunHeap, RunRss, Measures };
+    const char *names[Measures] = {
+        "Heap after init", "RSS after init", "Heap after run", "RSS after run"
+    };
+    vector<double> counts;
+    vector<double> deltas[Measures];
+
+    cout << "    " << left << setw(12) << "Instances";
+    for (int m = 0; m < Measures; ++m) {
+        if (m + 1 < Measures) cout << setw(18) << names[m];
+        else cout << names[m];
+    }
+    cout << endl;
+
+    for (int n = 1; n <= maxInstances; n *= 2) {
+
+        vector<Plugin *> instances;
+        for (int i = 0; i < n; ++i) {
+            Plugin *p = load(key, rate);
+            size_t ch = 0, st = 0, bl = 0;
+            Results subr;
+            if (!initDefaults(p, ch, st, bl, subr)) {
+                delete p;
+                break;
+            }
+            instances.push_back(p);
+        }
+        if (int(instances.size()) < n) {
+            for (size_t i = 0; i < instances.size(); ++i) delete instances[i];
+            r.push_back(warning("Initialisation failed with " + to_string(n) + " instances in existence at once"));
+            break;
+        }
+
+        long long measures[Measures];
+        measures[InitHeap] = heapBytes() - heap0;
+        measures[InitRss] = residentBytes() - rss0;
+
+        float **ptr = new float *[channels];
+        for (int i = 0; i < n; ++i) {
+            for (size_t j = 0; j < count; ++j) {
+                size_t idx = j * step;
+                for (size_t c = 0; c < channels; ++c) ptr[c] = data[c] + idx;
+                instances[i]->process(ptr, RealTime::frame2RealTime(idx, rate));
+            }
+            instances[i]->getRemainingFeatures();
+        }
+        delete[] ptr;
+
+        measures[RunHeap] = heapBytes() - heap0;
+        measures[RunRss] = residentBytes() - rss0;
+
+        for (int i = 0; i < n; ++i) delete instances[i];
+
+        if (heap0 < 0) measures[InitHeap] = measures[RunHeap] = -1;
+        if (rss0 < 0) measures[InitRss] = measures[RunRss] = -1;
+
+        cout << "    " << setw(12) << n;
+        for (int m = 0; m < Measures; ++m) {
+            if (m + 1 < Measures) cout << setw(18) << formatBytes(measures[m]);
+            else cout << formatBytes(measures[m]);
+            deltas[m].push_back(double(measures[m]));
+        }
+        cout << endl;
+        counts.push_back(n);
+    }
+
+    cout << right;
+    destroyTestAudio(data, channels);
+
+    if (counts.size() < 2) return r;
+
+    // Report the heap figures where we have them, as RSS is coarser
+    // and does not always shrink when memory is freed
+
+    bool useHeap = (deltas[InitHeap][0] >= 0);
+    int phases[2] = { useHeap ? InitHeap : InitRss,
+                      useHeap ? RunHeap : RunRss };
+    const char *phaseNames[2] = { "after initialise", "after a run" };
+
+    for (int ph = 0; ph < 2; ++ph) {
+        double a, b;
+        linearFit(counts, deltas[phases[ph]], a, b);
+        r.push_back(note(string(useHeap ? "Heap" : "Resident") + " memory " + phaseNames[ph] + ": " + formatBytes((long long)max(a, 0.0)) + " shared + " + formatBytes((long long)max(b, 0.0)) + " per instance"));
+    }
+
+    return r;
+}
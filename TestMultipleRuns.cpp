@@ -43,6 +43,9 @@
 using namespace Vamp;
 
 #include <memory>
+#include <iostream>
+#include <iomanip>
+#include <vector>
 using namespace std;
 
 #include <cmath>
@@ -59,6 +62,9 @@ TestInterleavedRuns::m_registrar("D3", "Simultaneous interleaved runs in a singl
 Tester::TestRegistrar<TestDifferentStartTimes>
 TestDifferentStartTimes::m_registrar("D4", "Consecutive runs with different start times");
 
+Tester::TestRegistrar<TestResetCost>
+TestResetCost::m_registrar("D5", "Cost of reset compared with a new instance", true);
+
 static const size_t _step = 1000;
 
 Test::Results
@@ -252,3 +258,113 @@ TestDifferentStartTimes::test(string key, Options options)
 
     return r;
 }
+
+Test::Results
+TestResetCost::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+    size_t channels = 0;
+    size_t count = 10;
+    const int iterations = 20;
+
+    // Pooling is recommended if reset and first process together are
+    // at least this many times cheaper than a new instance
+    const double worthwhile = 2.0;
+
+    // The pooled instance stays alive throughout, so that the plugin
+    // library remains loaded while new instances are made, as it
+    // would be in a host that runs more than one job at a time
+
+    unique_ptr<Plugin> pooled(load(key, rate));
+    if (!initAdapted(pooled.get(), channels, _step, _step, r)) return r;
+    float **data = createTestAudio(channels, _step, count);
+
+    // A short run between measurements, so that each instance has
+    // some state to discard
+    auto run = [&](Plugin *p, size_t from) {
+        float **ptr = new float *[channels];
+        for (size_t i = from; i < count; ++i) {
+            size_t idx = i * _step;
+            for (size_t c = 0; c < channels; ++c) ptr[c] = data[c] + idx;
+            p->process(ptr, RealTime::frame2RealTime(idx, rate));
+        }
+        delete[] ptr;
+        p->getRemainingFeatures();
+    };
+
+    // and the first process call of a run, which we time
+    auto first = [&](Plugin *p) {
+        long long start = nanoseconds();
+        p->process(data, RealTime::zeroTime);
+        return nanoseconds() - start;
+    };
+
+    vector<long long> resetTimes, resetFirstTimes;
+    run(pooled.get(), 0);
+    for (int i = 0; i < iterations; ++i) {
+        long long start = nanoseconds();
+        pooled->reset();
+        resetTimes.push_back(nanoseconds() - start);
+        resetFirstTimes.push_back(first(pooled.get()));
+        run(pooled.get(), 1);
+    }
+
+    vector<long long> loadTimes, initTimes, newFirstTimes, deleteTimes;
+    for (int i = 0; i < iterations; ++i) {
+        long long start = nanoseconds();
+        Plugin *p = load(key, rate);
+        loadTimes.push_back(nanoseconds() - start);
+        start = nanoseconds();
+        size_t ch = 0;
+        bool ok = initAdapted(p, ch, _step, _step, r);
+        initTimes.push_back(nanoseconds() - start);
+        if (!ok) {
+            delete p;
+            destroyTestAudio(data, channels);
+            return r;
+        }
+        newFirstTimes.push_back(first(p));
+        run(p, 1);
+        start = nanoseconds();
+        delete p;
+        deleteTimes.push_back(nanoseconds() - start);
+    }
+
+    destroyTestAudio(data, channels);
+
+    long long loadTime = median(loadTimes), initTime = median(initTimes);
+    long long newFirst = median(newFirstTimes), deleteTime = median(deleteTimes);
+    long long resetTime = median(resetTimes), resetFirst = median(resetFirstTimes);
+
+    long long newTotal = loadTime + initTime + newFirst + deleteTime;
+    long long resetTotal = resetTime + resetFirst;
+
+    cout << "    Median of " << iterations << " iterations:" << endl;
+    cout << "    " << left << setw(28) << "New instance: construct"
+         << formatDuration(loadTime) << endl;
+    cout << "    " << setw(28) << "              initialise"
+         << formatDuration(initTime) << endl;
+    cout << "    " << setw(28) << "              first process"
+         << formatDuration(newFirst) << endl;
+    cout << "    " << setw(28) << "              delete"
+         << formatDuration(deleteTime) << endl;
+    cout << "    " << setw(28) << "              total"
+         << formatDuration(newTotal) << endl;
+    cout << "    " << setw(28) << "Pooled:       reset"
+         << formatDuration(resetTime) << endl;
+    cout << "    " << setw(28) << "              first process"
+         << formatDuration(resetFirst) << endl;
+    cout << "    " << setw(28) << "              total"
+         << formatDuration(resetTotal) << endl;
+    cout << right;
+
+    if (resetTotal < 1) resetTotal = 1;
+    if (double(newTotal) / resetTotal >= worthwhile) {
+        r.push_back(note("Pooling instances with reset() is worthwhile: reset and first process take " + formatDuration(resetTotal) + ", against " + formatDuration(newTotal) + " for a new instance"));
+    } else {
+        r.push_back(note("Pooling instances with reset() gives little benefit: reset and first process take " + formatDuration(resetTotal) + ", against " + formatDuration(newTotal) + " for a new instance"));
+    }
+
+    return r;
+}
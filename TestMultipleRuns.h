@@ -83,4 +83,14 @@ protected:
     static Tester::TestRegistrar<TestDifferentStartTimes> m_registrar;
 };
 
+class TestResetCost : public Test
+{
+public:
+    TestResetCost() : Test() { }
+    Results test(std::string key, Options options);
+    
+protected:
+    static Tester::TestRegistrar<TestResetCost> m_registrar;
+};
+
 #endif
@@ -45,10 +45,17 @@ using namespace Vamp;
 using namespace Vamp::HostExt;
 
 #include <set>
+#include <map>
 #include <memory>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <functional>
 using namespace std;
 
 #include <cmath>
+#include <cstdlib>
 
 Tester::TestRegistrar<TestOutputNumbers>
 TestOutputNumbers::m_registrar("B1", "Output number mismatching");
@@ -56,8 +63,82 @@ TestOutputNumbers::m_registrar("B1", "Output number mismatching");
 Tester::TestRegistrar<TestTimestamps>
 TestTimestamps::m_registrar("B2", "Invalid or dubious timestamp usage");
 
+Tester::TestRegistrar<TestEmissionLag>
+TestEmissionLag::m_registrar("B3", "Feature emission lag");
+
+Tester::TestRegistrar<TestImpulseLatency>
+TestImpulseLatency::m_registrar("B4", "Latency of response to impulses");
+
+Tester::TestRegistrar<TestOutputVolume>
+TestOutputVolume::m_registrar("B5", "Volume of data returned per output");
+
 static const size_t _step = 1000;
 
+static double
+toSeconds(const RealTime &t)
+{
+    return t.sec + double(t.nsec) / 1000000000.0;
+}
+
+// The effective timestamp of the feature that is the index'th one
+// returned on the given output, following the rules for each sample
+// type; prev is the effective timestamp of the one before
+
+static RealTime
+featureTime(const Plugin::OutputDescriptor &o, const Plugin::Feature &f,
+            size_t index, const RealTime &prev, size_t step, int rate)
+{
+    switch (o.sampleType) {
+    case Plugin::OutputDescriptor::OneSamplePerStep:
+        return RealTime::frame2RealTime(index * step, rate);
+    case Plugin::OutputDescriptor::FixedSampleRate:
+        if (f.hasTimestamp) return f.timestamp;
+        if (index == 0 || o.sampleRate <= 0.f) return RealTime::zeroTime;
+        return prev + RealTime::fromSeconds(1.0 / o.sampleRate);
+    case Plugin::OutputDescriptor::VariableSampleRate:
+        break;
+    }
+    return f.timestamp;
+}
+
+// Called for each feature returned during a run, with its output
+// number, the index of the process call that returned it (or the
+// count of process calls, for getRemainingFeatures) and the timestamp
+// passed to that call (or the end of the input)
+
+typedef function<void(int output, const Plugin::Feature &,
+                      size_t call, const RealTime &callTime)>
+FeatureCallback;
+
+// Run an initialised plugin over count steps of the given audio,
+// followed by getRemainingFeatures, passing each returned feature to
+// onFeature as it arrives
+
+static void
+runFeatures(Plugin *p, float **data, size_t channels,
+            size_t step, size_t count, int rate,
+            const FeatureCallback &onFeature)
+{
+    float **ptr = new float *[channels];
+    for (size_t i = 0; i <= count; ++i) {
+        Plugin::FeatureSet fs;
+        RealTime timestamp = RealTime::frame2RealTime(i * step, rate);
+        if (i < count) {
+            for (size_t c = 0; c < channels; ++c) ptr[c] = data[c] + i * step;
+            fs = p->process(ptr, timestamp);
+        } else {
+            fs = p->getRemainingFeatures();
+        }
+        for (Plugin::FeatureSet::const_iterator fi = fs.begin();
+             fi != fs.end(); ++fi) {
+            for (size_t j = 0; j < fi->second.size(); ++j) {
+                onFeature(fi->first, fi->second[j], i, timestamp);
+            }
+        }
+    }
+    delete[] ptr;
+}
+
 Test::Results
 TestOutputNumbers::test(string key, Options options)
 {
@@ -174,3 +255,369 @@ TestTimestamps::test(string key, Options options)
     if (!r.empty() && (options & Verbose)) dump(f);
     return r;
 }
+
+Test::Results
+TestEmissionLag::test(string key, Options options)
+{
+    int rate = 44100;
+
+    // we want the plugin's own timing, not that of a buffering adapter:
+    unique_ptr<Plugin> p(load(key, rate, PluginLoader::ADAPT_ALL_SAFE));
+
+    Results r;
+    size_t channels = 0;
+    size_t step = 0, block = 0;
+
+    if (!initDefaults(p.get(), channels, step, block, r)) return r;
+
+    // Lag above which we mention an output even without -v, in seconds
+    const double noticeable = 1.0;
+
+    size_t count = size_t(10.0 * rate / step);
+    if (count < 1) count = 1;
+
+    Plugin::OutputList outputs = p->getOutputDescriptors();
+    size_t n = outputs.size();
+
+    // Per output: lag of each feature returned from process, in
+    // seconds, and count of features returned only at the end
+    vector<vector<double> > lags(n);
+    vector<size_t> atEnd(n, 0), indices(n, 0);
+    vector<RealTime> prev(n, RealTime::zeroTime);
+
+    float **data = createTestAudio(channels, block, count);
+    runFeatures(p.get(), data, channels, step, count, rate,
+                [&](int o, const Plugin::Feature &fe,
+                    size_t call, const RealTime &callTime) {
+                    if (o < 0 || o >= (int)n) return; // B1 reports this
+                    RealTime t = featureTime(outputs[o], fe, indices[o],
+                                             prev[o], step, rate);
+                    prev[o] = t;
+                    ++indices[o];
+                    if (call < count) {
+                        // features within the current block have no lag
+                        lags[o].push_back
+                            (max(0.0, toSeconds(callTime - t)));
+                    } else {
+                        ++atEnd[o];
+                    }
+                });
+    destroyTestAudio(data, channels);
+
+    double blockDuration = double(step) / rate;
+
+    if (options & Verbose) {
+        cout << "    " << left << setw(24) << "Output" << setw(22)
+             << "Median lag" << setw(22) << "Maximum lag"
+             << "Only at end" << endl;
+    }
+
+    for (size_t o = 0; o < n; ++o) {
+
+        size_t total = lags[o].size() + atEnd[o];
+        if (total == 0) continue; // B1 reports this
+
+        int endShare = int(100.0 * atEnd[o] / total + 0.5);
+
+        double med = 0, mx = 0;
+        if (!lags[o].empty()) {
+            vector<double> v(lags[o]);
+            sort(v.begin(), v.end());
+            med = v[v.size() / 2];
+            mx = v.back();
+        }
+
+        ostringstream ms, xs;
+        ms << fixed << setprecision(1) << med / blockDuration << " blocks ("
+           << setprecision(3) << med << "s)";
+        xs << fixed << setprecision(1) << mx / blockDuration << " blocks ("
+           << setprecision(3) << mx << "s)";
+
+        if (options & Verbose) {
+            cout << "    " << setw(24) << outputs[o].identifier;
+            if (lags[o].empty()) cout << setw(22) << "-" << setw(22) << "-";
+            else cout << setw(22) << ms.str() << setw(22) << xs.str();
+            cout << endShare << "%" << endl;
+        }
+
+        if (lags[o].empty()) {
+            r.push_back(note("All features on output \"" + outputs[o].identifier + "\" are returned only from getRemainingFeatures()"));
+            continue;
+        }
+        if (med > noticeable) {
+            r.push_back(note("Features on output \"" + outputs[o].identifier + "\" are returned a median of " + ms.str() + " after the input they describe (maximum " + xs.str() + ")"));
+        }
+        if (atEnd[o] > 0 && endShare >= 10) {
+            r.push_back(note(to_string(endShare) + "% of features on output \"" + outputs[o].identifier + "\" are returned only from getRemainingFeatures()"));
+        }
+    }
+
+    if (options & Verbose) cout << right;
+
+    return r;
+}
+
+Test::Results
+TestImpulseLatency::test(string key, Options options)
+{
+    int rate = 44100;
+    Results r;
+
+    // Ten impulses a little over a second apart, so that they fall at
+    // different offsets within the process blocks. Features more than
+    // a quarter of a second from any impulse are not matched to one
+    const int impulses = 10;
+    const double window = 0.25;
+    vector<size_t> positions;
+    for (int k = 0; k < impulses; ++k) {
+        positions.push_back((k + 1) * rate + k * 101);
+    }
+
+    // Each is tried as a single-sample impulse in silence, and as a
+    // click like those in createTestAudio over its sine tone
+
+    enum { Impulses, Clicks, Signals };
+    const char *names[Signals] = { "impulses", "clicks" };
+
+    unique_ptr<Plugin> p(load(key, rate, PluginLoader::ADAPT_ALL_SAFE));
+    size_t channels = 0, step = 0, block = 0;
+    if (!initDefaults(p.get(), channels, step, block, r)) return r;
+
+    Plugin::OutputList outputs = p->getOutputDescriptors();
+    size_t n = outputs.size();
+
+    size_t count = size_t((impulses + 2) * rate) / step;
+
+    // Per signal and output: offset of the nearest feature to each
+    // detected impulse, in seconds
+    vector<vector<vector<double> > > offsets
+        (Signals, vector<vector<double> >(n));
+
+    for (int s = 0; s < Signals; ++s) {
+
+        if (s > 0) p->reset();
+
+        float **data = createTestAudio(channels, block, count);
+        for (size_t c = 0; c < channels; ++c) {
+            if (s == Impulses) {
+                for (size_t i = 0; i < block * count; ++i) data[c][i] = 0.f;
+            } else {
+                // the plain sine, without createTestAudio's own clicks
+                for (size_t i = 0; i < block * count; ++i) {
+                    data[c][i] = testTone(i);
+                }
+            }
+            for (int k = 0; k < impulses; ++k) {
+                size_t i = positions[k];
+                if (s == Clicks) {
+                    data[c][i-2] = 0.f;
+                    data[c][i-1] = -1.f;
+                }
+                data[c][i] = 1.f;
+            }
+        }
+
+        Plugin::FeatureSet f;
+        runFeatures(p.get(), data, channels, step, count, rate,
+                    [&](int o, const Plugin::Feature &fe,
+                        size_t, const RealTime &) {
+                        f[o].push_back(fe);
+                    });
+        destroyTestAudio(data, channels);
+
+        for (Plugin::FeatureSet::const_iterator fi = f.begin();
+             fi != f.end(); ++fi) {
+            int o = fi->first;
+            if (o < 0 || o >= (int)n) continue; // B1 reports this
+            if (outputs[o].sampleType !=
+                Plugin::OutputDescriptor::VariableSampleRate) continue;
+            const Plugin::FeatureList &fl = fi->second;
+            // an output with many more features than impulses is not
+            // responding to them as events
+            if (fl.size() > size_t(impulses * 3)) continue;
+            for (int k = 0; k < impulses; ++k) {
+                double it = double(positions[k]) / rate;
+                bool found = false;
+                double best = 0;
+                for (size_t j = 0; j < fl.size(); ++j) {
+                    double d = toSeconds(fl[j].timestamp) - it;
+                    if (fabs(d) > window) continue;
+                    if (!found || fabs(d) < fabs(best)) best = d;
+                    found = true;
+                }
+                if (found) offsets[s][o].push_back(best);
+            }
+        }
+    }
+
+    if (options & Verbose) {
+        cout << "    " << left << setw(24) << "Output" << setw(12)
+             << "Input" << setw(12) << "Detected" << setw(16)
+             << "Median offset" << "Spread" << endl;
+    }
+
+    for (size_t o = 0; o < n; ++o) {
+
+        if (outputs[o].sampleType !=
+            Plugin::OutputDescriptor::VariableSampleRate) continue;
+
+        int chosen = -1;
+        for (int s = 0; s < Signals; ++s) {
+
+            vector<double> v(offsets[s][o]);
+            if (v.empty()) continue;
+            sort(v.begin(), v.end());
+            double med = v[v.size() / 2];
+
+            if (options & Verbose) {
+                ostringstream ms, ss;
+                // avoid printing rounding error as "-0.0"
+                if (fabs(med) < 0.00005) med = 0.0;
+                ms << fixed << setprecision(1) << med * 1000.0 << "ms";
+                ss << fixed << setprecision(1)
+                   << (v.back() - v.front()) * 1000.0 << "ms";
+                cout << "    " << setw(24) << outputs[o].identifier
+                     << setw(12) << names[s]
+                     << setw(12) << (to_string(v.size()) + "/" +
+                                     to_string(impulses))
+                     << setw(16) << ms.str() << ss.str() << endl;
+            }
+
+            if (v.size() * 2 < size_t(impulses)) continue;
+            if (chosen < 0 || v.size() > offsets[chosen][o].size()) {
+                chosen = s;
+            }
+        }
+
+        if (chosen < 0) continue;
+
+        vector<double> v(offsets[chosen][o]);
+        sort(v.begin(), v.end());
+        double med = v[v.size() / 2];
+        long frames = lrint(med * rate);
+
+        ostringstream os;
+        os << "Output \"" << outputs[o].identifier << "\" reports "
+           << names[chosen] << " ";
+        if (frames == 0) {
+            os << "with no systematic offset";
+        } else {
+            os << fixed << setprecision(1) << fabs(med) * 1000.0 << "ms ("
+               << labs(frames) << " samples) "
+               << (frames > 0 ? "late" : "early");
+        }
+        os << " (" << v.size() << " of " << impulses << " detected, spread "
+           << fixed << setprecision(1) << (v.back() - v.front()) * 1000.0
+           << "ms)";
+        r.push_back(note(os.str()));
+    }
+
+    if (options & Verbose) cout << right;
+
+    return r;
+}
+
+Test::Results
+TestOutputVolume::test(string key, Options options)
+{
+    int rate = 44100;
+
+    // we want the plugin's own step size, not that of an adapter:
+    unique_ptr<Plugin> p(load(key, rate, PluginLoader::ADAPT_ALL_SAFE));
+
+    Results r;
+    size_t channels = 0;
+    size_t step = 0, block = 0;
+
+    if (!initDefaults(p.get(), channels, step, block, r)) return r;
+
+    // Outputs producing more than this per hour of audio are noted
+    // even without -v
+    const long long large = 100LL * 1024 * 1024;
+
+    size_t count = size_t(20.0 * rate / step);
+    if (count < 1) count = 1;
+
+    Plugin::FeatureSet f;
+    float **data = createTestAudio(channels, block, count);
+    runFeatures(p.get(), data, channels, step, count, rate,
+                [&](int o, const Plugin::Feature &fe,
+                    size_t, const RealTime &) {
+                    f[o].push_back(fe);
+                });
+    destroyTestAudio(data, channels);
+
+    double audio = double(count * step) / rate;
+    Plugin::OutputList outputs = p->getOutputDescriptors();
+
+    if (options & Verbose) {
+        cout << "    " << left << setw(24) << "Output" << setw(14)
+             << "Features/s" << setw(14) << "Values each" << setw(14)
+             << "Label bytes" << "Per hour" << endl;
+    }
+
+    for (int o = 0; o < (int)outputs.size(); ++o) {
+
+        const Plugin::OutputDescriptor &od = outputs[o];
+        const Plugin::FeatureList &fl = f[o];
+        if (fl.empty()) continue; // B1 reports this
+
+        // Size of each feature as a host might store it: four bytes
+        // per value, the label, and eight bytes for each of timestamp
+        // and duration when present
+        long long values = 0, labels = 0, bytes = 0;
+        size_t maxValues = 0;
+        for (size_t j = 0; j < fl.size(); ++j) {
+            const Plugin::Feature &fe = fl[j];
+            values += fe.values.size();
+            labels += fe.label.size();
+            maxValues = max(maxValues, fe.values.size());
+            bytes += 4 * fe.values.size() + fe.label.size() +
+                (fe.hasTimestamp ? 8 : 0) + (fe.hasDuration ? 8 : 0);
+        }
+
+        double perSecond = fl.size() / audio;
+        long long perHour = (long long)(bytes * (3600.0 / audio));
+
+        if (options & Verbose) {
+            ostringstream fs, vs, ls;
+            fs << fixed << setprecision(1) << perSecond;
+            vs << fixed << setprecision(1) << double(values) / fl.size();
+            ls << fixed << setprecision(1) << double(labels) / fl.size();
+            cout << "    " << setw(24) << od.identifier << setw(14)
+                 << fs.str() << setw(14) << vs.str() << setw(14)
+                 << ls.str() << formatBytes(perHour) << endl;
+        }
+
+        // The number of features the descriptor allows for in the
+        // audio we gave, if it implies one at all
+
+        double expected = -1;
+        if (od.sampleType == Plugin::OutputDescriptor::OneSamplePerStep) {
+            expected = count;
+        } else if (od.sampleType == Plugin::OutputDescriptor::FixedSampleRate &&
+                   od.sampleRate > 0.f) {
+            expected = audio * od.sampleRate;
+        }
+
+        if (expected >= 0 && fl.size() > expected * 1.01 + 1) {
+            ostringstream os;
+            os << fixed << setprecision(1) << "Output \"" << od.identifier
+               << "\" returns " << perSecond << " features per second, more than the "
+               << expected / audio << " its descriptor implies";
+            r.push_back(warning(os.str()));
+        }
+
+        if (expected >= 0 && od.hasFixedBinCount && maxValues > od.binCount) {
+            r.push_back(warning("Output \"" + od.identifier + "\" returns features with up to " + to_string(maxValues) + " values, more than its bin count of " + to_string(od.binCount)));
+        }
+
+        if (perHour > large) {
+            r.push_back(note("Output \"" + od.identifier + "\" returns about " + formatBytes(perHour) + " of feature data per hour of audio"));
+        }
+    }
+
+    if (options & Verbose) cout << right;
+
+    return r;
+}
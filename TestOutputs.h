@@ -63,5 +63,34 @@ protected:
     static Tester::TestRegistrar<TestTimestamps> m_registrar;
 };
 
+class TestEmissionLag : public Test
+{
+public:
+    TestEmissionLag() : Test() { }
+    Results test(std::string key, Options options);
+    
+protected:
+    static Tester::TestRegistrar<TestEmissionLag> m_registrar;
+};
+
+class TestImpulseLatency : public Test
+{
+public:
+    TestImpulseLatency() : Test() { }
+    Results test(std::string key, Options options);
+    
+protected:
+    static Tester::TestRegistrar<TestImpulseLatency> m_registrar;
+};
+
+class TestOutputVolume : public Test
+{
+public:
+    TestOutputVolume() : Test() { }
+    Results test(std::string key, Options options);
+    
+protected:
+    static Tester::TestRegistrar<TestOutputVolume> m_registrar;
+};
 
 #endif
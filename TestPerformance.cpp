@@ -0,0 +1,1440 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp Plugin Tester
+    Chris Cannam, cannam@all-day-breakfast.com
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2009-2014 QMUL.
+
+    This program loads a Vamp plugin and tests its susceptibility to a
+    number of common pitfalls, including handling of extremes of input
+    data.  If you can think of any additional useful tests that are
+    easily added, please send them to me.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+#include "TestPerformance.h"
+
+#include <vamp-hostsdk/Plugin.h>
+#include <vamp-hostsdk/PluginLoader.h>
+#include <vamp-hostsdk/PluginInputDomainAdapter.h>
+using namespace Vamp;
+using namespace Vamp::HostExt;
+
+#include <memory>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <set>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <functional>
+using namespace std;
+
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define HAVE_MXCSR 1
+#endif
+
+Tester::TestRegistrar<TestSoak>
+TestSoak::m_registrar("H1", "Long-running soak", true);
+
+Tester::TestRegistrar<TestBlockSizes>
+TestBlockSizes::m_registrar("H2", "Block and step size throughput", true);
+
+Tester::TestRegistrar<TestAdapterOverhead>
+TestAdapterOverhead::m_registrar("H3", "Adapter overhead", true);
+
+Tester::TestRegistrar<TestNonPowerOfTwo>
+TestNonPowerOfTwo::m_registrar("H4", "Non-power-of-two block sizes", true);
+
+Tester::TestRegistrar<TestDenormals>
+TestDenormals::m_registrar("H5", "Denormal input", true);
+
+Tester::TestRegistrar<TestComplexity>
+TestComplexity::m_registrar("H6", "Processing cost by input duration", true);
+
+Tester::TestRegistrar<TestDeferredWork>
+TestDeferredWork::m_registrar("H7", "Work deferred to getRemainingFeatures", true);
+
+Tester::TestRegistrar<TestParameterCost>
+TestParameterCost::m_registrar("H8", "Processing cost across parameter ranges", true);
+
+Tester::TestRegistrar<TestShortClips>
+TestShortClips::m_registrar("H9", "Workload of many short clips", true);
+
+// Run an initialised plugin over count steps of the test signal,
+// with a click every second, generated a block at a time, returning
+// the time spent in process calls and in the final
+// getRemainingFeatures call. Features are discarded. If given,
+// beforeRemaining is called just before getRemainingFeatures, outside
+// the timed part
+
+static void
+streamRun(Plugin *p, float **block, size_t channels,
+          size_t step, size_t blocksize, size_t count, int rate,
+          long long &processTime, long long &remainingTime,
+          const function<void()> &beforeRemaining = function<void()>())
+{
+    processTime = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t idx = i * step;
+        for (size_t j = 0; j < blocksize; ++j) {
+            float v = Test::testSample(idx + j, rate);
+            for (size_t c = 0; c < channels; ++c) block[c][j] = v;
+        }
+        RealTime timestamp = RealTime::frame2RealTime(idx, rate);
+        long long t0 = Test::nanoseconds();
+        p->process(block, timestamp);
+        processTime += Test::nanoseconds() - t0;
+    }
+    if (beforeRemaining) beforeRemaining();
+    long long t0 = Test::nanoseconds();
+    p->getRemainingFeatures();
+    remainingTime = Test::nanoseconds() - t0;
+}
+
+Test::Results
+TestSoak::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+    unique_ptr<Plugin> p(load(key, rate));
+    size_t channels, step, blocksize;
+    if (!initDefaults(p.get(), channels, step, blocksize, r)) return r;
+
+    Plugin::OutputList outputs = p->getOutputDescriptors();
+
+    size_t count = size_t(soakDuration() * rate / step);
+    if (count < 1) count = 1;
+    const size_t intervals = 20;
+    size_t perInterval = count / intervals;
+    if (perInterval < 1) perInterval = 1;
+
+    // Features are counted and validated as they arrive, and then
+    // discarded, so that our own memory use remains bounded however
+    // long the run
+
+    long long features = 0;
+    bool invalid = false, badOutput = false, noTimestamp = false;
+
+    vector<long long> latencies;
+    latencies.reserve(perInterval);
+    vector<long long> memory;        // heap if known, else RSS
+    vector<long long> medians;
+
+    cout << "    " << left
+         << setw(12) << "Input" << setw(12) << "Elapsed"
+         << setw(12) << "RSS" << setw(12) << "Heap"
+         << setw(12) << "Median call" << setw(12) << "99th %ile"
+         << setw(12) << "Max call" << "Features" << endl;
+
+    float **block = createBlock(channels, blocksize);
+    long long start = nanoseconds();
+
+    for (size_t i = 0; i <= count; ++i) {
+
+        Plugin::FeatureSet fs;
+
+        if (i < count) {
+            size_t idx = i * step;
+            for (size_t j = 0; j < blocksize; ++j) {
+                float v = testSample(idx + j, rate);
+                for (size_t c = 0; c < channels; ++c) block[c][j] = v;
+            }
+            RealTime timestamp = RealTime::frame2RealTime(idx, rate);
+            long long t0 = nanoseconds();
+            fs = p->process(block, timestamp);
+            latencies.push_back(nanoseconds() - t0);
+        } else {
+            long long t0 = nanoseconds();
+            fs = p->getRemainingFeatures();
+            latencies.push_back(nanoseconds() - t0);
+        }
+
+        if (!allFeaturesValid(fs)) invalid = true;
+        for (Plugin::FeatureSet::const_iterator fi = fs.begin();
+             fi != fs.end(); ++fi) {
+            if (fi->first < 0 || fi->first >= int(outputs.size())) {
+                badOutput = true;
+                continue;
+            }
+            features += fi->second.size();
+            if (outputs[fi->first].sampleType ==
+                Plugin::OutputDescriptor::VariableSampleRate) {
+                for (size_t j = 0; j < fi->second.size(); ++j) {
+                    if (!fi->second[j].hasTimestamp) noTimestamp = true;
+                }
+            }
+        }
+
+        if ((i + 1) % perInterval != 0 && i < count) continue;
+
+        long long rss = residentBytes(), heap = heapBytes();
+        memory.push_back(heap >= 0 ? heap : rss);
+
+        sort(latencies.begin(), latencies.end());
+        long long med = latencies[latencies.size() / 2];
+        long long p99 = latencies[(latencies.size() * 99) / 100];
+        medians.push_back(med);
+
+        cout << "    "
+             << setw(12) << formatDuration((long long)(1e9 * double(min(i + 1, count) * step) / rate))
+             << setw(12) << formatDuration(nanoseconds() - start)
+             << setw(12) << formatBytes(rss) << setw(12) << formatBytes(heap)
+             << setw(12) << formatDuration(med) << setw(12) << formatDuration(p99)
+             << setw(12) << formatDuration(latencies[latencies.size() - 1])
+             << features << endl;
+
+        latencies.clear();
+    }
+
+    long long elapsed = nanoseconds() - start;
+    destroyBlock(block, channels);
+    cout << right;
+
+    if (invalid) {
+        r.push_back(warning("Plugin returned one or more NaN/inf values"));
+    }
+    if (badOutput) {
+        r.push_back(error("Data returned on nonexistent output"));
+    }
+    if (noTimestamp) {
+        r.push_back(error("Plugin returns features with no timestamps on VariableSampleRate output"));
+    }
+
+    double seconds = double(count * step) / rate;
+    ostringstream os;
+    os << fixed << setprecision(1) << (seconds * 1e9) / double(max(elapsed, 1LL));
+    r.push_back(note("Soak run processed " + formatDuration((long long)(seconds * 1e9)) +
+                     " of input in " + formatDuration(elapsed) + " (" + os.str() +
+                     "x real-time), returning " + to_string(features) + " features"));
+
+    // Compare the end of the run against the end of the first
+    // interval, by which time any initial allocations and warm-up
+    // should be done with
+
+    if (memory.size() > 2 && memory[0] >= 0) {
+        long long growth = memory[memory.size() - 1] - memory[0];
+        if (growth > 16 * 1048576LL) {
+            r.push_back(warning("Memory use grew by " + formatBytes(growth) +
+                                " during soak run (leak or unbounded buffering?)"));
+        }
+    }
+    if (medians.size() > 2 && medians[0] > 0) {
+        // the last entry includes getRemainingFeatures, so use the
+        // one before it
+        double ratio = double(medians[medians.size() - 2]) / medians[0];
+        if (ratio > 2.0) {
+            ostringstream rs;
+            rs << fixed << setprecision(1) << ratio;
+            r.push_back(warning("Process calls became " + rs.str() +
+                                " times slower over the course of a soak run"));
+        }
+    }
+
+    return r;
+}
+
+// Throughput as a multiple of real-time, formatted for a table cell
+static string
+formatThroughput(double throughput)
+{
+    ostringstream os;
+    os << fixed << setprecision(throughput < 10.0 ? 2 : 1) << throughput;
+    return os.str();
+}
+
+Test::Results
+TestBlockSizes::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+    const double seconds = 5.0;
+    const int trials = 3;
+
+    // Load without a buffering adapter, so that the plugin itself
+    // sees the block and step sizes we ask for
+    const int flags = PluginLoader::ADAPT_ALL_SAFE;
+
+    size_t preferredBlock = 0, preferredStep = 0;
+    {
+        unique_ptr<Plugin> p(load(key, rate, flags));
+        preferredBlock = p->getPreferredBlockSize();
+        preferredStep = p->getPreferredStepSize();
+        if (preferredBlock == 0) preferredBlock = 1024;
+        if (preferredStep == 0) preferredStep = preferredBlock;
+    }
+
+    set<pair<size_t, size_t> > configs;
+    for (size_t block = 256; block <= 8192; block *= 2) {
+        for (size_t div = 1; div <= 4; div *= 2) {
+            configs.insert(make_pair(block, block / div));
+        }
+    }
+    configs.insert(make_pair(preferredBlock, preferredStep));
+
+    size_t maxBlock = 0;
+    set<size_t> blocks, steps;
+    for (set<pair<size_t, size_t> >::const_iterator i = configs.begin();
+         i != configs.end(); ++i) {
+        blocks.insert(i->first);
+        steps.insert(i->second);
+        if (i->first > maxBlock) maxBlock = i->first;
+    }
+
+    size_t frames = size_t(seconds * rate);
+    float **data = 0;
+    size_t channels = 0;
+
+    map<pair<size_t, size_t>, double> throughput;
+
+    for (set<pair<size_t, size_t> >::const_iterator i = configs.begin();
+         i != configs.end(); ++i) {
+
+        size_t block = i->first, step = i->second;
+
+        unique_ptr<Plugin> p(load(key, rate, flags));
+        Results subr;
+        if (!initAdapted(p.get(), channels, step, block, subr)) {
+            // Refusing a size is fine, it just isn't in the running
+            continue;
+        }
+
+        if (!data) data = createTestAudio(channels, 1, frames + maxBlock);
+        size_t count = frames / step;
+
+        long long best = 0;
+        for (int trial = 0; trial < trials; ++trial) {
+            if (trial > 0) p->reset();
+            long long processTime = 0, remainingTime = 0;
+            timeRun(p.get(), data, channels, step, count, rate,
+                    processTime, remainingTime);
+            long long t = processTime + remainingTime;
+            if (trial == 0 || t < best) best = t;
+        }
+        if (best < 1) best = 1;
+        throughput[*i] = (double(count * step) / rate) / (double(best) / 1e9);
+    }
+
+    if (data) destroyTestAudio(data, channels);
+
+    if (throughput.empty()) {
+        r.push_back(warning("Plugin could not be initialised with any of the block and step sizes tried"));
+        return r;
+    }
+
+    pair<size_t, size_t> fastest = throughput.begin()->first;
+    for (map<pair<size_t, size_t>, double>::const_iterator i =
+             throughput.begin(); i != throughput.end(); ++i) {
+        if (i->second > throughput[fastest]) fastest = i->first;
+    }
+    pair<size_t, size_t> preferred(preferredBlock, preferredStep);
+
+    // Table of throughput (as a multiple of real-time) with a row for
+    // each block size and a column for each step size. The fastest
+    // configuration is marked * and the preferred one p
+
+    cout << "    Throughput (x real-time) by block size (rows) and step size (columns):" << endl;
+    cout << "    " << setw(8) << " ";
+    for (set<size_t>::const_iterator si = steps.begin(); si != steps.end(); ++si) {
+        cout << setw(10) << *si;
+    }
+    cout << endl;
+    for (set<size_t>::const_iterator bi = blocks.begin(); bi != blocks.end(); ++bi) {
+        cout << "    " << setw(8) << *bi;
+        for (set<size_t>::const_iterator si = steps.begin(); si != steps.end(); ++si) {
+            pair<size_t, size_t> c(*bi, *si);
+            string cell;
+            if (throughput.find(c) != throughput.end()) {
+                cell = formatThroughput(throughput[c]);
+                if (c == fastest) cell += "*";
+                if (c == preferred) cell += "p";
+            } else if (configs.find(c) != configs.end()) {
+                cell = "-";
+            }
+            cout << setw(10) << cell;
+        }
+        cout << endl;
+    }
+    cout << "    (- = refused by plugin)" << endl;
+
+    ostringstream os;
+    os << "Fastest configuration is block size " << fastest.first
+       << ", step size " << fastest.second << " at "
+       << formatThroughput(throughput[fastest]) << "x real-time";
+    if (throughput.find(preferred) != throughput.end()) {
+        os << "; preferred block size " << preferred.first
+           << ", step size " << preferred.second << " gives "
+           << formatThroughput(throughput[preferred]) << "x real-time";
+    } else {
+        os << "; plugin refused its own preferred block size "
+           << preferred.first << ", step size " << preferred.second;
+    }
+    r.push_back(note(os.str()));
+
+    return r;
+}
+
+// A frequency-domain "plugin" that does nothing but keep a copy of
+// each frame of input it is given. Wrapped in a
+// PluginInputDomainAdapter, it records exactly what the adapter would
+// pass to a real frequency-domain plugin
+
+class FrameCapture : public Plugin
+{
+public:
+    FrameCapture(float rate, vector<vector<vector<float> > > &frames) :
+        Plugin(rate), m_frames(frames), m_channels(0), m_block(0) { }
+
+    string getIdentifier() const { return "framecapture"; }
+    string getName() const { return "Frame Capture"; }
+    string getDescription() const { return ""; }
+    string getMaker() const { return ""; }
+    string getCopyright() const { return ""; }
+    int getPluginVersion() const { return 1; }
+
+    InputDomain getInputDomain() const { return FrequencyDomain; }
+    size_t getMaxChannelCount() const { return 1024; }
+
+    bool initialise(size_t channels, size_t, size_t block) {
+        m_channels = channels;
+        m_block = block;
+        return true;
+    }
+    void reset() { m_frames.clear(); }
+
+    OutputList getOutputDescriptors() const { return OutputList(); }
+
+    FeatureSet process(const float *const *input, RealTime) {
+        vector<vector<float> > frame(m_channels);
+        for (size_t c = 0; c < m_channels; ++c) {
+            frame[c].assign(input[c], input[c] + m_block + 2);
+        }
+        m_frames.push_back(frame);
+        return FeatureSet();
+    }
+    FeatureSet getRemainingFeatures() { return FeatureSet(); }
+
+private:
+    vector<vector<vector<float> > > &m_frames;
+    size_t m_channels;
+    size_t m_block;
+};
+
+// Transform each step of the given audio into the interleaved real
+// and imaginary form that a frequency-domain plugin expects, by
+// running it through the SDK's own input domain adapter. This is done
+// ahead of time so that it does not contribute to any timing. Returns
+// fewer than count frames if the adapter refuses the block size
+
+static vector<vector<vector<float> > >
+transformAudio(float **audio, size_t channels, size_t block, size_t step,
+               size_t count, int rate)
+{
+    vector<vector<vector<float> > > frames;
+    frames.reserve(count);
+    PluginInputDomainAdapter adapter(new FrameCapture(rate, frames));
+    if (!adapter.initialise(channels, step, block)) return frames;
+    const float **ptr = new const float *[channels];
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t c = 0; c < channels; ++c) {
+            ptr[c] = audio[c] + i * step;
+        }
+        adapter.process(ptr, RealTime::frame2RealTime(i * step, rate));
+    }
+    delete[] ptr;
+    return frames;
+}
+
+Test::Results
+TestAdapterOverhead::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+    const double seconds = 5.0;
+    const int trials = 3;
+
+    enum {
+        None, InputDomain, Channel, MaxChannels, ChannelMixing, Buffering,
+        Stacks
+    };
+    const char *names[Stacks] = {
+        "No adapters",
+        "+ PluginInputDomainAdapter",
+        "+ PluginChannelAdapter",
+        "  (max channels, no mixing)",
+        "  (mixing down extra channels)",
+        "+ PluginBufferingAdapter"
+    };
+    const int flags[Stacks] = {
+        0,
+        PluginLoader::ADAPT_INPUT_DOMAIN,
+        PluginLoader::ADAPT_INPUT_DOMAIN | PluginLoader::ADAPT_CHANNEL_COUNT,
+        PluginLoader::ADAPT_INPUT_DOMAIN,
+        PluginLoader::ADAPT_INPUT_DOMAIN | PluginLoader::ADAPT_CHANNEL_COUNT,
+        PluginLoader::ADAPT_ALL
+    };
+
+    // Mixing down is only measured for plugins accepting up to this
+    // many channels, so as not to allocate huge amounts of test audio
+    const size_t maxMixChannels = 16;
+
+    // All stacks use the plugin's own preferred step and block size
+    // and minimum channel count, so that the plugin itself does the
+    // same work in every case, except for the mixing stack and its
+    // reference. These run the plugin at its maximum channel count,
+    // with and without an extra channel for the adapter to mix
+    // down. The buffering adapter is fed non-overlapping blocks of one
+    // step each
+
+    size_t block, step, channels, maxChannels;
+    bool frequencyDomain;
+    {
+        unique_ptr<Plugin> p(load(key, rate, 0));
+        frequencyDomain = (p->getInputDomain() == Plugin::FrequencyDomain);
+        block = p->getPreferredBlockSize();
+        step = p->getPreferredStepSize();
+        channels = p->getMinChannelCount();
+        maxChannels = p->getMaxChannelCount();
+        if (block == 0) block = 1024;
+        if (step == 0) step = (frequencyDomain ? block/2 : block);
+    }
+
+    size_t count = size_t(seconds * rate) / step;
+    bool mixing = (maxChannels < maxMixChannels);
+    size_t mixChannels = (mixing ? maxChannels + 1 : 0);
+    size_t dataChannels = max(channels, mixChannels);
+    float **data = createTestAudio(dataChannels, 1, count * step + block);
+
+    vector<vector<vector<float> > > transformed;
+    if (frequencyDomain) {
+        transformed = transformAudio(data, channels, block, step, count,
+                                     rate);
+    }
+
+    long long elapsed[Stacks];
+    bool done[Stacks];
+
+    for (int s = 0; s < Stacks; ++s) {
+
+        done[s] = false;
+        if (s == InputDomain && !frequencyDomain) continue;
+        if (s == None && frequencyDomain && transformed.size() < count) {
+            continue;
+        }
+        if ((s == MaxChannels || s == ChannelMixing) && !mixing) continue;
+
+        unique_ptr<Plugin> p(load(key, rate, flags[s]));
+        size_t c = channels;
+        if (s == MaxChannels) c = maxChannels;
+        if (s == ChannelMixing) c = mixChannels;
+        size_t hostBlock = (s == Buffering ? step : block);
+        if (!p->initialise(c, step, hostBlock)) continue;
+
+        long long best = 0;
+        for (int trial = 0; trial < trials; ++trial) {
+            if (trial > 0) p->reset();
+            long long processTime = 0, remainingTime = 0;
+            if (s == None && frequencyDomain) {
+                float **ptr = new float *[c];
+                for (size_t i = 0; i < count; ++i) {
+                    for (size_t ch = 0; ch < c; ++ch) {
+                        ptr[ch] = &transformed[i][ch][0];
+                    }
+                    // timestamp of the centre of the frame, as the
+                    // input domain adapter would give it
+                    RealTime timestamp = RealTime::frame2RealTime
+                        (i * step + block/2, rate);
+                    long long start = nanoseconds();
+                    p->process(ptr, timestamp);
+                    processTime += nanoseconds() - start;
+                }
+                delete[] ptr;
+                long long start = nanoseconds();
+                p->getRemainingFeatures();
+                remainingTime = nanoseconds() - start;
+            } else {
+                timeRun(p.get(), data, c, step, count, rate,
+                        processTime, remainingTime);
+            }
+            long long t = processTime + remainingTime;
+            if (trial == 0 || t < best) best = t;
+        }
+        elapsed[s] = best;
+        done[s] = true;
+    }
+
+    destroyTestAudio(data, dataChannels);
+
+    if (!done[None]) {
+        r.push_back(note("Plugin could not be initialised without adapters at its preferred block size " + to_string(block) + " and step size " + to_string(step) + ", so adapter overhead could not be measured"));
+        return r;
+    }
+
+    double audio = double(count * step) / rate;
+
+    cout << "    Block size " << block << ", step size " << step
+         << ", " << channels << " channel(s)"
+         << (frequencyDomain ? ", frequency-domain plugin" : "") << endl;
+    if (mixing) {
+        cout << "    Bracketed rows run the plugin at its maximum of "
+             << maxChannels << " channel(s)" << endl;
+    }
+    cout << "    " << left << setw(32) << "Adapters" << setw(18)
+         << "Per sec of audio" << setw(14) << "Throughput"
+         << "Added by this adapter" << endl;
+
+    long long previous = elapsed[None];
+    for (int s = 0; s < Stacks; ++s) {
+        cout << "    " << setw(32) << names[s];
+        if (!done[s]) {
+            if (s == InputDomain && !frequencyDomain) {
+                cout << "(not used for time-domain plugins)" << endl;
+            } else if ((s == MaxChannels || s == ChannelMixing) && !mixing) {
+                cout << "(plugin accepts too many channels)" << endl;
+            } else {
+                cout << "(plugin could not be initialised)" << endl;
+            }
+            continue;
+        }
+        long long perSecond = (long long)(elapsed[s] / audio);
+        cout << setw(18) << formatDuration(perSecond)
+             << setw(14) << formatThroughput(audio / (elapsed[s] / 1e9)) + "x";
+        // MaxChannels is only a reference for ChannelMixing, which is
+        // compared with it as both run the plugin at the same channel
+        // count; the remaining stacks are compared with the layer below
+        long long base = previous;
+        if (s == ChannelMixing && done[MaxChannels]) {
+            base = elapsed[MaxChannels];
+        }
+        if (s != None && s != MaxChannels) {
+            long long diff = elapsed[s] - base;
+            cout << (diff < 0 ? "-" : "+")
+                 << formatDuration((long long)(llabs(diff) / audio));
+        }
+        cout << endl;
+        if (s != MaxChannels && s != ChannelMixing) previous = elapsed[s];
+    }
+    cout << right;
+
+    if (done[Buffering]) {
+        double share = 1.0 - double(elapsed[None]) / elapsed[Buffering];
+        if (share < 0.0) share = 0.0;
+        ostringstream os;
+        os << fixed << setprecision(0) << share * 100;
+        r.push_back(note("Adapters account for " + os.str() + "% of processing time when loaded with ADAPT_ALL"));
+    }
+
+    return r;
+}
+
+Test::Results
+TestNonPowerOfTwo::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+    const double seconds = 5.0;
+    const int trials = 3;
+
+    // How much slower than the neighbouring power of two a block size
+    // must be before we call it a cliff
+    const double threshold = 2.0;
+
+    {
+        unique_ptr<Plugin> p(load(key, rate, 0));
+        if (p->getInputDomain() != Plugin::FrequencyDomain) {
+            r.push_back(note("Plugin is not frequency-domain, so non-power-of-two block sizes were not tested"));
+            return r;
+        }
+    }
+
+    // Each power of two is accompanied by its even neighbours (odd
+    // sizes cannot be given to a real FFT) and by a round decimal
+    // size in the same range
+
+    struct Size { size_t block; size_t powerOfTwo; };
+    vector<Size> sizes;
+    for (size_t p2 = 512; p2 <= 8192; p2 *= 2) {
+        Size s;
+        s.powerOfTwo = p2;
+        s.block = p2; sizes.push_back(s);
+        s.block = p2 - 2; sizes.push_back(s);
+        s.block = p2 + 2; sizes.push_back(s);
+        s.block = (p2 * 1000) / 1024; sizes.push_back(s);
+    }
+
+    size_t frames = size_t(seconds * rate);
+    float **data = 0;
+    size_t channels = 0;
+
+    map<size_t, long long> elapsed;
+    map<size_t, size_t> audioFrames;
+
+    for (int i = 0; i < int(sizes.size()); ++i) {
+
+        size_t block = sizes[i].block, step = block / 2;
+
+        unique_ptr<Plugin> p(load(key, rate, PluginLoader::ADAPT_ALL_SAFE));
+        Results subr;
+        if (!initAdapted(p.get(), channels, step, block, subr)) continue;
+
+        if (!data) data = createTestAudio(channels, 1, frames + 8192 + 2);
+        size_t count = frames / step;
+
+        long long best = 0;
+        for (int trial = 0; trial < trials; ++trial) {
+            if (trial > 0) p->reset();
+            long long processTime = 0, remainingTime = 0;
+            timeRun(p.get(), data, channels, step, count, rate,
+                    processTime, remainingTime);
+            long long t = processTime + remainingTime;
+            if (trial == 0 || t < best) best = t;
+        }
+        elapsed[block] = (best < 1 ? 1 : best);
+        audioFrames[block] = count * step;
+    }
+
+    if (data) destroyTestAudio(data, channels);
+
+    cout << "    " << left << setw(12) << "Block size" << setw(14)
+         << "Throughput" << "Relative to power of two" << endl;
+
+    for (int i = 0; i < int(sizes.size()); ++i) {
+
+        size_t block = sizes[i].block, p2 = sizes[i].powerOfTwo;
+
+        cout << "    " << setw(12) << block;
+        if (elapsed.find(block) == elapsed.end()) {
+            cout << "(refused by plugin)" << endl;
+            continue;
+        }
+
+        double throughput =
+            (double(audioFrames[block]) / rate) / (elapsed[block] / 1e9);
+        cout << setw(14) << formatThroughput(throughput) + "x";
+
+        if (block == p2 || elapsed.find(p2) == elapsed.end()) {
+            cout << endl;
+            continue;
+        }
+
+        double reference =
+            (double(audioFrames[p2]) / rate) / (elapsed[p2] / 1e9);
+        double slowdown = reference / throughput;
+        cout << formatThroughput(1.0 / slowdown) << endl;
+
+        if (slowdown > threshold) {
+            r.push_back(warning("Throughput collapses at non-power-of-two block size " + to_string(block) + ": " + formatThroughput(slowdown) + " times slower than at block size " + to_string(p2)));
+        }
+    }
+    cout << right;
+
+    return r;
+}
+
+// Read the floating-point control register of the calling thread into
+// mode, returning false if we don't know how to on this platform
+
+static bool
+getFloatMode(unsigned long long &mode)
+{
+#if defined(HAVE_MXCSR)
+    mode = _mm_getcsr();
+    return true;
+#elif defined(__aarch64__) && defined(__GNUC__)
+    __asm__ __volatile__ ("mrs %0, fpcr" : "=r" (mode));
+    return true;
+#else
+    (void)mode;
+    return false;
+#endif
+}
+
+static void
+setFloatMode(unsigned long long mode)
+{
+#if defined(HAVE_MXCSR)
+    _mm_setcsr((unsigned int)mode);
+#elif defined(__aarch64__) && defined(__GNUC__)
+    __asm__ __volatile__ ("msr fpcr, %0" : : "r" (mode));
+#else
+    (void)mode;
+#endif
+}
+
+// Set or clear the flush-to-zero and denormals-are-zero modes for
+// the calling thread, returning false if we don't know how to on this
+// platform. Threads started by the plugin itself are not affected
+
+static bool
+setFlushToZero(bool on)
+{
+#if defined(HAVE_MXCSR)
+    const unsigned long long bits = 0x8040; // FTZ | DAZ
+#elif defined(__aarch64__) && defined(__GNUC__)
+    const unsigned long long bits = (1ULL << 24); // FZ
+#else
+    const unsigned long long bits = 0;
+#endif
+    unsigned long long mode = 0;
+    if (!getFloatMode(mode)) return false;
+    if (on) mode |= bits;
+    else mode &= ~bits;
+    setFloatMode(mode);
+    return true;
+}
+
+Test::Results
+TestDenormals::test(string key, Options options)
+{
+    int rate = 44100;
+    Results r;
+    const double seconds = 5.0;
+    const int trials = 3;
+
+    // How much faster processing must be with flush-to-zero before we
+    // say the plugin is badly affected by denormals
+    const double threshold = 2.0;
+
+    // The caller's mode is put back after each run, since the host
+    // may have chosen a mode of its own
+    unsigned long long savedMode = 0;
+    if (!getFloatMode(savedMode)) {
+        r.push_back(note("Flush-to-zero mode cannot be set on this platform, so denormal handling was not tested"));
+        return r;
+    }
+
+    size_t step = 1000;
+    size_t count = size_t(seconds * rate) / step;
+    size_t frames = count * step;
+
+    // A normal signal for reference; a signal that decays
+    // exponentially over the first quarter, from full scale to far
+    // below the smallest float, leaving any filters in the plugin to
+    // ring down through the subnormal range for the remainder; and
+    // noise at an amplitude straddling the smallest normal float
+
+    enum { Normal, Decaying, TinyNoise, Signals };
+    const char *names[Signals] = {
+        "Normal signal", "Decaying to silence", "Tiny noise"
+    };
+
+    size_t channels = 0;
+    {
+        unique_ptr<Plugin> p(load(key, rate));
+        channels = p->getMinChannelCount();
+    }
+
+    long long elapsed[Signals][2];
+    Plugin::FeatureSet f[Signals][2];
+
+    for (int s = 0; s < Signals; ++s) {
+
+        float **data = createTestAudio(channels, step, count);
+        for (size_t i = 0; i < frames; ++i) {
+            float v = data[0][i];
+            if (s == Decaying) {
+                double level = -60.0 * double(i) / (frames / 4);
+                v = float(v * pow(10.0, max(level, -300.0)));
+            } else if (s == TinyNoise) {
+                v = float((double(rand()) / RAND_MAX * 2.0 - 1.0) * 2e-38);
+            }
+            for (size_t c = 0; c < channels; ++c) data[c][i] = v;
+        }
+
+        for (int ftz = 0; ftz < 2; ++ftz) {
+
+            unique_ptr<Plugin> p(load(key, rate));
+            if (!initAdapted(p.get(), channels, step, step, r)) {
+                destroyTestAudio(data, channels);
+                return r;
+            }
+
+            long long best = 0;
+            for (int trial = 0; trial < trials; ++trial) {
+                if (trial > 0) p->reset();
+                Plugin::FeatureSet fs;
+                long long processTime = 0, remainingTime = 0;
+                setFlushToZero(ftz == 1);
+                timeRun(p.get(), data, channels, step, count, rate,
+                        processTime, remainingTime, &fs);
+                setFloatMode(savedMode);
+                long long t = processTime + remainingTime;
+                if (trial == 0 || t < best) best = t;
+                if (trial == 0) f[s][ftz] = fs;
+            }
+            elapsed[s][ftz] = (best < 1 ? 1 : best);
+        }
+
+        destroyTestAudio(data, channels);
+    }
+
+    double audio = double(frames) / rate;
+
+    cout << "    " << left << setw(22) << "Input" << setw(16)
+         << "FTZ/DAZ off" << setw(16) << "FTZ/DAZ on" << "Speed-up" << endl;
+    for (int s = 0; s < Signals; ++s) {
+        double off = audio / (elapsed[s][0] / 1e9);
+        double on = audio / (elapsed[s][1] / 1e9);
+        cout << "    " << setw(22) << names[s]
+             << setw(16) << formatThroughput(off) + "x"
+             << setw(16) << formatThroughput(on) + "x"
+             << formatThroughput(on / off) << endl;
+    }
+    cout << right;
+
+    bool valid = true;
+
+    for (int s = Decaying; s < Signals; ++s) {
+
+        string input = string(names[s]);
+        input[0] = tolower(input[0]);
+        
+        double ratio = double(elapsed[s][0]) / elapsed[s][1];
+        double normalRatio = double(elapsed[s][0]) / elapsed[Normal][0];
+        if (ratio > threshold) {
+            r.push_back(warning("Processing " + input + " is " + formatThroughput(ratio) + " times slower without flush-to-zero (" + formatThroughput(normalRatio) + " times slower than a normal signal): plugin is badly affected by denormals"));
+        }
+
+        if (!allFeaturesValid(f[s][0]) || !allFeaturesValid(f[s][1])) {
+            valid = false;
+        }
+
+        if (!(f[s][0] == f[s][1])) {
+            Result res = note("Results for " + input + " change when flush-to-zero is enabled");
+            if (options & Verbose) dumpDiff(res, f[s][0], f[s][1]);
+            r.push_back(res);
+        }
+    }
+
+    if (!valid) {
+        r.push_back(warning("Plugin returned one or more NaN/inf values"));
+    }
+
+    return r;
+}
+
+Test::Results
+TestComplexity::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+
+    // Durations double from 5 seconds up to 320, but we stop early
+    // once the runs so far have taken more than a minute, as long as
+    // we have enough points to fit a curve to
+    const double shortest = 5.0;
+    const int maxRuns = 7, minRuns = 3;
+    const long long budget = 60LL * 1000000000LL;
+
+    // getRemainingFeatures times are only fitted if the longest run
+    // spends at least this long in it; anything less is swamped by
+    // timing noise and of no practical concern
+    const long long significant = 10LL * 1000000LL;
+
+    // A fitted exponent above this is "clearly" super-linear
+    const double threshold = 1.3;
+
+    vector<double> durations, processTimes, remainingTimes;
+    long long total = 0;
+
+    cout << "    " << left << setw(12) << "Duration" << setw(14)
+         << "process()" << setw(14) << "Per second"
+         << "getRemainingFeatures()" << endl;
+
+    for (int run = 0; run < maxRuns; ++run) {
+
+        if (run >= minRuns && total > budget) break;
+
+        double seconds = shortest * (1 << run);
+
+        unique_ptr<Plugin> p(load(key, rate));
+        size_t channels, step, blocksize;
+        if (!initDefaults(p.get(), channels, step, blocksize, r)) {
+            cout << right;
+            return r;
+        }
+
+        size_t count = size_t(seconds * rate / step);
+        if (count < 1) count = 1;
+
+        float **block = createBlock(channels, blocksize);
+        long long processTime = 0, remainingTime = 0;
+        streamRun(p.get(), block, channels, step, blocksize, count, rate,
+                  processTime, remainingTime);
+        destroyBlock(block, channels);
+
+        total += processTime + remainingTime;
+
+        double audio = double(count * step) / rate;
+        durations.push_back(audio);
+        processTimes.push_back(double(max(processTime, 1LL)));
+        remainingTimes.push_back(double(max(remainingTime, 1LL)));
+
+        cout << "    " << setw(12) << (to_string(int(audio + 0.5)) + "s")
+             << setw(14) << formatDuration(processTime)
+             << setw(14) << formatDuration(processTime / audio)
+             << formatDuration(remainingTime) << endl;
+    }
+
+    cout << right;
+
+    // Fit only the longer runs, where the costs that grow with the
+    // input dominate fixed overheads such as allocation at startup
+    size_t from = (durations.size() - 1) / 2;
+    durations.erase(durations.begin(), durations.begin() + from);
+    processTimes.erase(processTimes.begin(), processTimes.begin() + from);
+    remainingTimes.erase(remainingTimes.begin(), remainingTimes.begin() + from);
+
+    double kp = growthExponent(durations, processTimes);
+    ostringstream os;
+    os << fixed << setprecision(2) << kp;
+    string summary = "Time in process() grows as input duration to the power " + os.str();
+    if (kp > threshold) {
+        r.push_back(warning("Time spent in process() grows faster than linearly with input duration (power " + os.str() + "), so long inputs may take a very long time"));
+    }
+
+    if (remainingTimes.back() >= significant) {
+        double kr = growthExponent(durations, remainingTimes);
+        os.str("");
+        os << kr;
+        summary += ", in getRemainingFeatures() to the power " + os.str();
+        if (kr > threshold) {
+            r.push_back(warning("Time spent in getRemainingFeatures() grows faster than linearly with input duration (power " + os.str() + "), so long inputs may take a very long time"));
+        }
+    } else {
+        summary += "; time in getRemainingFeatures() is negligible";
+    }
+
+    r.push_back(note(summary));
+    return r;
+}
+
+Test::Results
+TestDeferredWork::test(string key, Options options)
+{
+    int rate = 44100;
+    Results r;
+    const double seconds = 30.0;
+
+    // Shares of the total CPU time spent in getRemainingFeatures at
+    // which we call a plugin partially deferred and offline-only
+    const double partial = 0.1, offline = 0.5;
+
+    // Memory allocated during getRemainingFeatures beyond the peak
+    // during process calls is counted as significant if it is more
+    // than this and more than the growth during process calls
+    const long long significantMemory = 4 * 1024 * 1024;
+
+    unique_ptr<Plugin> p(load(key, rate));
+    size_t channels, step, blocksize;
+    if (!initDefaults(p.get(), channels, step, blocksize, r)) return r;
+
+    bool useHeap = (heapBytes() >= 0);
+    auto memory = [useHeap]() {
+        return useHeap ? heapBytes() : residentBytes();
+    };
+    bool haveMemory = (memory() >= 0);
+
+    size_t count = size_t(seconds * rate / step);
+    if (count < 1) count = 1;
+
+    // Memory use is sampled from another thread throughout the run,
+    // with the peak recorded separately for the process calls and for
+    // the single getRemainingFeatures call
+
+    long long base = memory();
+    atomic<bool> done(false), remaining(false);
+    atomic<long long> processPeak(base), remainingPeak(base);
+    auto sample = [&]() {
+        long long m = memory();
+        atomic<long long> &peak = (remaining ? remainingPeak : processPeak);
+        long long prev = peak;
+        while (m > prev && !peak.compare_exchange_weak(prev, m)) { }
+    };
+    thread sampler;
+    if (haveMemory) {
+        sampler = thread([&]() {
+                while (!done) {
+                    sample();
+                    this_thread::sleep_for(chrono::milliseconds(1));
+                }
+            });
+    }
+
+    float **block = createBlock(channels, blocksize);
+    long long processTime = 0, remainingTime = 0;
+    streamRun(p.get(), block, channels, step, blocksize, count, rate,
+              processTime, remainingTime,
+              [&]() {
+                  if (haveMemory) sample();
+                  remainingPeak = processPeak.load();
+                  remaining = true;
+              });
+    destroyBlock(block, channels);
+
+    done = true;
+    if (sampler.joinable()) sampler.join();
+    if (haveMemory) sample();
+
+    long long total = max(processTime + remainingTime, 1LL);
+    double cpuShare = double(remainingTime) / total;
+
+    long long processGrowth = max(processPeak - base, 0LL);
+    long long remainingGrowth = max(remainingPeak - processPeak, 0LL);
+    bool memoryDeferred = haveMemory &&
+        remainingGrowth > significantMemory &&
+        remainingGrowth > processGrowth;
+
+    string classification;
+    if (cpuShare >= offline) {
+        classification = "offline-only";
+    } else if (cpuShare >= partial || memoryDeferred) {
+        classification = "partially deferred";
+    } else {
+        classification = "streaming";
+    }
+
+    if (options & Verbose) {
+        cout << "    process() " << formatDuration(processTime)
+             << ", getRemainingFeatures() " << formatDuration(remainingTime)
+             << " (" << int(cpuShare * 100 + 0.5) << "%)" << endl;
+        if (haveMemory) {
+            cout << "    Memory growth during process() "
+                 << formatBytes(processGrowth)
+                 << ", further growth during getRemainingFeatures() "
+                 << formatBytes(remainingGrowth) << endl;
+        }
+    }
+
+    string m = "Plugin classified as " + classification + ": " +
+        to_string(int(cpuShare * 100 + 0.5)) +
+        "% of processing time is spent in getRemainingFeatures()";
+    if (memoryDeferred) {
+        m += ", which also needs " + formatBytes(remainingGrowth) +
+            " more memory than process()";
+    }
+    r.push_back(note(m));
+    return r;
+}
+
+// Values to try for a parameter: its extremes and default, and
+// points evenly spread between, rounded to its quantize step if it
+// has one
+
+static vector<float>
+parameterValues(const Plugin::ParameterDescriptor &pd)
+{
+    const int points = 7;
+    set<float> values;
+    values.insert(pd.minValue);
+    values.insert(pd.maxValue);
+    values.insert(pd.defaultValue);
+    for (int i = 1; i < points - 1; ++i) {
+        float v = pd.minValue + (pd.maxValue - pd.minValue) * i / (points - 1);
+        if (pd.isQuantized && pd.quantizeStep > 0.f) {
+            v = pd.minValue + pd.quantizeStep *
+                roundf((v - pd.minValue) / pd.quantizeStep);
+            if (v > pd.maxValue) v = pd.maxValue;
+        }
+        values.insert(v);
+    }
+    return vector<float>(values.begin(), values.end());
+}
+
+Test::Results
+TestParameterCost::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+    const double seconds = 3.0;
+    const int trials = 3;
+
+    // How much slower than at the default a parameter must make
+    // processing before we say it drives cost
+    const double threshold = 2.0;
+
+    Plugin::ParameterList params;
+    {
+        unique_ptr<Plugin> p(load(key, rate));
+        params = p->getParameterDescriptors();
+    }
+
+    if (params.empty()) {
+        r.push_back(note("Plugin has no parameters"));
+        return r;
+    }
+
+    // Throughput (x real-time) with the given parameter at the given
+    // value and all others at their defaults, or a negative value if
+    // the plugin could not be initialised. Parameters are set before
+    // initialise, as a host would, since some of them may change the
+    // preferred block size
+
+    auto measure = [&](string id, float value, bool set) -> double {
+        unique_ptr<Plugin> p(load(key, rate));
+        if (set) p->setParameter(id, value);
+        size_t channels, step, block;
+        Results subr;
+        if (!initDefaults(p.get(), channels, step, block, subr)) return -1;
+        size_t count = size_t(seconds * rate / step);
+        if (count < 1) count = 1;
+        float **data = createTestAudio(channels, block, count);
+        long long best = 0;
+        for (int trial = 0; trial < trials; ++trial) {
+            if (trial > 0) p->reset();
+            long long processTime = 0, remainingTime = 0;
+            timeRun(p.get(), data, channels, step, count, rate,
+                    processTime, remainingTime);
+            long long t = processTime + remainingTime;
+            if (trial == 0 || t < best) best = t;
+        }
+        destroyTestAudio(data, channels);
+        if (best < 1) best = 1;
+        return (double(count * step) / rate) / (double(best) / 1e9);
+    };
+
+    double reference = measure("", 0.f, false);
+    if (reference < 0) {
+        r.push_back(error("initialisation with default values failed"));
+        return r;
+    }
+
+    cout << "    All parameters at defaults: "
+         << formatThroughput(reference) << "x real-time" << endl;
+
+    for (size_t i = 0; i < params.size(); ++i) {
+
+        const Plugin::ParameterDescriptor &pd = params[i];
+        vector<float> values = parameterValues(pd);
+
+        cout << "    Parameter \"" << pd.identifier << "\":" << endl;
+
+        float worst = pd.defaultValue;
+        double worstThroughput = reference;
+        vector<float> refused;
+
+        for (size_t j = 0; j < values.size(); ++j) {
+            double t = measure(pd.identifier, values[j], true);
+            ostringstream os;
+            os << values[j];
+            cout << "        " << left << setw(14) << os.str() << right;
+            if (t < 0) {
+                cout << "refused" << endl;
+                refused.push_back(values[j]);
+            } else {
+                cout << formatThroughput(t) << "x" << endl;
+                if (t < worstThroughput) {
+                    worstThroughput = t;
+                    worst = values[j];
+                }
+            }
+        }
+
+        double slowdown = reference / worstThroughput;
+        ostringstream ws, ds;
+        ws << worst;
+        ds << pd.defaultValue;
+
+        if (slowdown > threshold) {
+            r.push_back(note("Parameter \"" + pd.identifier + "\" drives processing cost: " + formatThroughput(slowdown) + " times slower at " + ws.str() + " than at its default of " + ds.str()));
+        }
+        if (worstThroughput < 1.0 && reference >= 1.0) {
+            r.push_back(warning("Plugin runs slower than real-time with parameter \"" + pd.identifier + "\" set to " + ws.str() + " (" + formatThroughput(worstThroughput) + "x)"));
+        }
+        if (!refused.empty()) {
+            ostringstream os;
+            for (size_t j = 0; j < refused.size(); ++j) {
+                if (j > 0) os << ", ";
+                os << refused[j];
+            }
+            r.push_back(note("Initialisation failed with parameter \"" + pd.identifier + "\" set to " + os.str()));
+        }
+    }
+
+    return r;
+}
+
+Test::Results
+TestShortClips::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+
+    // A batch of clips of between 2 and 10 seconds, the same for each
+    // way of running them, each starting at a different point in the
+    // streamed test signal
+    const int clips = 50;
+    const double shortest = 2.0, longest = 10.0;
+
+    minstd_rand random(42);
+    uniform_real_distribution<double> lengthDist(shortest, longest);
+    vector<size_t> lengths, offsets;
+    for (int i = 0; i < clips; ++i) {
+        lengths.push_back(size_t(lengthDist(random) * rate));
+        offsets.push_back(size_t(random() % rate) * 60);
+    }
+
+    enum { PerClip, Pooled, Modes };
+    const char *names[Modes] = {
+        "Instance per clip", "Pooled with reset"
+    };
+    enum { Setup, Initialise, Process, Remaining, Phases };
+
+    // Total time in each phase. Only time spent in the plugin is
+    // counted, not the time taken to generate the input
+    long long phase[Modes][Phases];
+    long long total[Modes];
+
+    for (int m = 0; m < Modes; ++m) {
+
+        for (int ph = 0; ph < Phases; ++ph) phase[m][ph] = 0;
+
+        unique_ptr<Plugin> pooled;
+        size_t channels = 0, step = 0, block = 0;
+
+        if (m == Pooled) {
+            long long start = nanoseconds();
+            pooled.reset(load(key, rate));
+            phase[m][Setup] += nanoseconds() - start;
+            start = nanoseconds();
+            if (!initDefaults(pooled.get(), channels, step, block, r)) return r;
+            phase[m][Initialise] += nanoseconds() - start;
+        }
+
+        float **buf = 0;
+
+        for (int i = 0; i < clips; ++i) {
+
+            Plugin *p = pooled.get();
+
+            if (m == PerClip) {
+                long long start = nanoseconds();
+                p = load(key, rate);
+                phase[m][Setup] += nanoseconds() - start;
+                start = nanoseconds();
+                bool ok = initDefaults(p, channels, step, block, r);
+                phase[m][Initialise] += nanoseconds() - start;
+                if (!ok) {
+                    delete p;
+                    if (buf) destroyBlock(buf, channels);
+                    return r;
+                }
+            } else if (i > 0) {
+                long long start = nanoseconds();
+                p->reset();
+                phase[m][Setup] += nanoseconds() - start;
+            }
+
+            if (!buf) buf = createBlock(channels, block);
+
+            size_t count = (lengths[i] + step - 1) / step;
+            for (size_t j = 0; j < count; ++j) {
+                size_t idx = j * step;
+                for (size_t k = 0; k < block; ++k) {
+                    float v = (idx + k < lengths[i] ?
+                               testSample(offsets[i] + idx + k, rate) : 0.f);
+                    for (size_t c = 0; c < channels; ++c) buf[c][k] = v;
+                }
+                RealTime timestamp = RealTime::frame2RealTime(idx, rate);
+                long long start = nanoseconds();
+                p->process(buf, timestamp);
+                phase[m][Process] += nanoseconds() - start;
+            }
+
+            long long start = nanoseconds();
+            p->getRemainingFeatures();
+            phase[m][Remaining] += nanoseconds() - start;
+
+            if (m == PerClip) {
+                start = nanoseconds();
+                delete p;
+                phase[m][Setup] += nanoseconds() - start;
+            }
+        }
+
+        if (buf) destroyBlock(buf, channels);
+
+        long long start = nanoseconds();
+        pooled.reset();
+        phase[m][Setup] += nanoseconds() - start;
+
+        total[m] = 0;
+        for (int ph = 0; ph < Phases; ++ph) total[m] += phase[m][ph];
+        if (total[m] < 1) total[m] = 1;
+    }
+
+    double audio = 0;
+    for (int i = 0; i < clips; ++i) audio += double(lengths[i]) / rate;
+
+    cout << "    " << clips << " clips of " << shortest << "-" << longest
+         << " seconds, " << int(audio + 0.5) << " seconds of audio in all"
+         << endl;
+    cout << "    " << left << setw(20) << "" << setw(12) << "Clips/s"
+         << setw(12) << "Overhead" << setw(12) << "Setup"
+         << setw(12) << "Initialise" << setw(12) << "Process"
+         << "Remaining" << endl;
+
+    // The fixed overhead per clip is everything but process calls,
+    // whose cost depends on the length of the clip
+    long long overhead[Modes];
+    for (int m = 0; m < Modes; ++m) {
+        overhead[m] = (total[m] - phase[m][Process]) / clips;
+        ostringstream cs;
+        cs << fixed << setprecision(1) << clips / (total[m] / 1e9);
+        cout << "    " << setw(20) << names[m] << setw(12) << cs.str()
+             << setw(12) << formatDuration(overhead[m]);
+        for (int ph = 0; ph < Phases; ++ph) {
+            string cell = formatDuration(phase[m][ph] / clips);
+            if (ph + 1 < Phases) cout << setw(12) << cell;
+            else cout << cell;
+        }
+        cout << endl;
+    }
+    cout << right;
+
+    cout << "    (Times are means per clip. Overhead is all but the process calls;" << endl
+         << "    setup is construction and deletion for an instance per clip, and" << endl
+         << "    reset for a pooled instance)" << endl;
+
+    long long processPerClip = phase[PerClip][Process] / clips;
+    double share = double(overhead[PerClip]) /
+        (overhead[PerClip] + processPerClip + 1);
+
+    r.push_back(note("With an instance per clip, fixed overhead is " + formatDuration(overhead[PerClip]) + " per clip (" + to_string(int(share * 100 + 0.5)) + "% of the total), against " + formatDuration(overhead[Pooled]) + " with a pooled instance; " + formatThroughput(clips / (total[PerClip] / 1e9)) + " against " + formatThroughput(clips / (total[Pooled] / 1e9)) + " clips per second"));
+
+    return r;
+}
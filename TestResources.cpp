@@ -0,0 +1,502 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp Plugin Tester
+    Chris Cannam, cannam@all-day-breakfast.com
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2009-2014 QMUL.
+
+    This program loads a Vamp plugin and tests its susceptibility to a
+    number of common pitfalls, including handling of extremes of input
+    data.  If you can think of any additional useful tests that are
+    easily added, please send them to me.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+#include "TestResources.h"
+#include "SyscallAudit.h"
+
+#include <vamp-hostsdk/Plugin.h>
+#include <vamp-hostsdk/PluginLoader.h>
+using namespace Vamp;
+using namespace Vamp::HostExt;
+
+#include <memory>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+using namespace std;
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+Tester::TestRegistrar<TestThreadSpawning>
+TestThreadSpawning::m_registrar("J1", "Threads started by plugin");
+
+Tester::TestRegistrar<TestSyscalls>
+TestSyscalls::m_registrar("J2", "System calls during processing");
+
+Tester::TestRegistrar<TestStackUsage>
+TestStackUsage::m_registrar("J3", "Stack usage");
+
+static const size_t _step = 1000;
+
+Test::Results
+TestThreadSpawning::test(string key, Options options)
+{
+    int rate = 44100;
+    Results r;
+    const int instances = 4;
+    size_t count = 441; // 10 seconds at our step size
+
+    int baseline = processThreads();
+    if (baseline < 0 || processCpuTime() < 0 || threadCpuTime() < 0) {
+        r.push_back(note("Threads cannot be counted on this platform"));
+        return r;
+    }
+
+    // Several instances, so that per-instance figures are not
+    // confused with a single pool of threads shared by all of them
+
+    enum { Construct, Initialise, Process, Destroy, Phases };
+    const char *names[Phases] = {
+        "construction", "initialise", "processing", "destruction"
+    };
+    int after[Phases];
+    int peak = baseline;
+
+    vector<Plugin *> plugins;
+    for (int i = 0; i < instances; ++i) plugins.push_back(load(key, rate));
+    after[Construct] = processThreads();
+
+    size_t channels = 0;
+    for (int i = 0; i < instances; ++i) {
+        if (!initAdapted(plugins[i], channels, _step, _step, r)) {
+            for (int j = 0; j < instances; ++j) delete plugins[j];
+            return r;
+        }
+    }
+    after[Initialise] = processThreads();
+
+    float **data = createTestAudio(channels, _step, count);
+    float **ptr = new float *[channels];
+
+    // Any CPU time the process uses beyond that of this thread while
+    // the plugins are processing belongs to threads the plugins
+    // started (or woke)
+    long long cpu0 = processCpuTime(), thread0 = threadCpuTime();
+
+    for (int i = 0; i < instances; ++i) {
+        for (size_t j = 0; j < count; ++j) {
+            size_t idx = j * _step;
+            for (size_t c = 0; c < channels; ++c) ptr[c] = data[c] + idx;
+            plugins[i]->process(ptr, RealTime::frame2RealTime(idx, rate));
+            peak = max(peak, processThreads());
+        }
+        plugins[i]->getRemainingFeatures();
+    }
+
+    long long total = processCpuTime() - cpu0;
+    long long offThread = total - (threadCpuTime() - thread0);
+    if (offThread < 0) offThread = 0;
+
+    delete[] ptr;
+    destroyTestAudio(data, channels);
+    after[Process] = processThreads();
+
+    for (int i = 0; i < instances; ++i) delete plugins[i];
+
+    // Allow a little time for threads to finish exiting after being
+    // told to stop
+    for (int i = 0; i < 10; ++i) {
+        after[Destroy] = processThreads();
+        if (after[Destroy] <= baseline) break;
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    if (options & Verbose) {
+        cout << "    Threads in process: " << baseline << " at start";
+        for (int ph = 0; ph < Phases; ++ph) {
+            cout << ", " << after[ph] << " after " << names[ph];
+        }
+        cout << " (peak " << peak << ")" << endl;
+        cout << "    CPU time during processing: " << formatDuration(total)
+             << ", of which " << formatDuration(offThread)
+             << " on other threads" << endl;
+    }
+
+    int started = peak - baseline;
+    for (int ph = 0; ph < Destroy; ++ph) {
+        started = max(started, after[ph] - baseline);
+    }
+    if (started > 0) {
+        ostringstream os;
+        os << fixed << setprecision(1) << double(started) / instances;
+        r.push_back(note("Plugin starts its own threads: " + os.str() + " per instance, with " + to_string(instances) + " instances"));
+    }
+
+    int left = after[Destroy] - baseline;
+    if (left > 0) {
+        r.push_back(warning(to_string(left) + " thread(s) started by the plugin are still running after all instances have been deleted"));
+    }
+
+    if (total > 0 && offThread * 10 > total) {
+        r.push_back(note(formatDuration(offThread) + " of CPU time (" + to_string(int(100.0 * offThread / total + 0.5)) + "% of the total) was used on threads other than the calling one during processing"));
+    }
+
+    return r;
+}
+
+// Value of a "key: value" or "key value" line in a file under
+// /proc/thread-self, or -1 if there is no such file or line (as on
+// platforms other than Linux)
+
+static long long
+threadStat(const char *file, const char *key)
+{
+    string path = string("/proc/thread-self/") + file;
+    FILE *f = fopen(path.c_str(), "r");
+    if (!f) return -1;
+    char line[256];
+    long long value = -1;
+    size_t n = strlen(key);
+    while (fgets(line, sizeof(line), f)) {
+        if (!strncmp(line, key, n) && line[n] == ':') {
+            value = atoll(line + n + 1);
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+struct KernelCounts {
+    long long reads, writes, switches;
+    KernelCounts() :
+        reads(threadStat("io", "syscr")),
+        writes(threadStat("io", "syscw")),
+        switches(threadStat("status", "voluntary_ctxt_switches")) { }
+    bool valid() const { return reads >= 0 && writes >= 0 && switches >= 0; }
+};
+
+Test::Results
+TestSyscalls::test(string key, Options options)
+{
+    int rate = 44100;
+    Results r;
+    size_t count = 441; // 10 seconds at our step size
+
+    bool interposed = SyscallAudit::available();
+    if (!interposed && !KernelCounts().valid()) {
+        r.push_back(note("System calls cannot be audited on this platform"));
+        return r;
+    }
+
+    unique_ptr<Plugin> p(load(key, rate));
+    size_t channels = 0;
+    if (!initAdapted(p.get(), channels, _step, _step, r)) return r;
+
+    float **data = createTestAudio(channels, _step, count);
+    float **ptr = new float *[channels];
+
+    // Reading the kernel's counts makes read calls of its own, so we
+    // take two readings back to back to find out how many, and then
+    // subtract that from the difference across processing
+    KernelCounts k0;
+    KernelCounts k1;
+    long long readOverhead = k1.reads - k0.reads;
+
+    if (interposed) SyscallAudit::begin();
+    for (size_t i = 0; i < count; ++i) {
+        size_t idx = i * _step;
+        for (size_t c = 0; c < channels; ++c) ptr[c] = data[c] + idx;
+        p->process(ptr, RealTime::frame2RealTime(idx, rate));
+    }
+    p->getRemainingFeatures();
+    if (interposed) SyscallAudit::end();
+
+    KernelCounts k2;
+
+    delete[] ptr;
+    destroyTestAudio(data, channels);
+
+    long long kernelReads = -1, kernelWrites = -1, switches = -1;
+    if (k1.valid() && k2.valid()) {
+        kernelReads = max(k2.reads - k1.reads - readOverhead, 0LL);
+        kernelWrites = max(k2.writes - k1.writes, 0LL);
+        switches = max(k2.switches - k1.switches, 0LL);
+    }
+
+    string io, waits;
+    int ioCalls = 0, sleepCalls = 0, waitCalls = 0;
+    for (int i = 0; i < SyscallAudit::Calls; ++i) {
+        SyscallAudit::Call c = SyscallAudit::Call(i);
+        int n = SyscallAudit::count(c);
+        if (n == 0) continue;
+        string desc = to_string(n) + " " + SyscallAudit::name(c);
+        if (SyscallAudit::isIO(c)) {
+            if (io != "") io += ", ";
+            io += desc;
+            ioCalls += n;
+        } else if (SyscallAudit::isWait(c)) {
+            if (waits != "") waits += ", ";
+            waits += desc;
+            waitCalls += n;
+        } else {
+            sleepCalls += n;
+        }
+    }
+
+    if (options & Verbose) {
+        if (interposed) {
+            cout << "    C library calls during processing:";
+            bool any = false;
+            for (int i = 0; i < SyscallAudit::Calls; ++i) {
+                SyscallAudit::Call c = SyscallAudit::Call(i);
+                if (SyscallAudit::count(c) == 0) continue;
+                cout << " " << SyscallAudit::name(c) << " "
+                     << SyscallAudit::count(c);
+                any = true;
+            }
+            if (!any) cout << " none";
+            cout << endl;
+        } else {
+            cout << "    C library calls not audited (wrappers not exported from the tester executable?)" << endl;
+        }
+        if (switches >= 0) {
+            cout << "    Kernel: " << kernelReads << " read and "
+                 << kernelWrites << " write system calls, "
+                 << switches << " voluntary context switches" << endl;
+        }
+    }
+
+    if (ioCalls > 0) {
+        r.push_back(warning("Plugin performs I/O while processing: " + io));
+    } else if (kernelReads > 0 || kernelWrites > 0) {
+        // stdio and the like make their system calls within the C
+        // library, where we cannot see them by name
+        r.push_back(warning("Plugin performs I/O while processing: " + to_string(kernelReads) + " read and " + to_string(kernelWrites) + " write system calls"));
+    }
+
+    if (sleepCalls > 0) {
+        r.push_back(warning("Plugin sleeps or yields while processing (" + to_string(sleepCalls) + " call(s))"));
+    }
+
+    if (waitCalls > 0) {
+        r.push_back(note("Plugin waits on other threads while processing: " + waits));
+    } else if (switches > 0 && ioCalls == 0 && sleepCalls == 0) {
+        r.push_back(note("Processing thread blocked " + to_string(switches) + " time(s), perhaps waiting for a lock or for memory to be paged in"));
+    }
+
+    return r;
+}
+
+#ifndef _WIN32
+
+static const uintptr_t _stackPattern = uintptr_t(0x5a5a5a5a5a5a5a5aULL);
+
+// Lowest address in the stack that no longer holds the pattern.
+// Stacks grow downwards on every platform we build for
+
+static char *
+stackHighWater(char *low, char *top)
+{
+    const uintptr_t *w = (const uintptr_t *)low;
+    while ((const char *)w < top && *w == _stackPattern) ++w;
+    return (char *)w;
+}
+
+struct StackRun {
+    enum Phase { Initialise, Process };
+    Phase phase;
+    Plugin *plugin;
+    char *low;
+    int rate;
+    size_t channels, step, block;
+    float **data;
+    size_t count;
+    bool initialised;
+    long long used;
+    Test::Results results;
+};
+
+// Thread function for one phase of TestStackUsage, run on a stack
+// freshly filled with the pattern. The depth used is measured from
+// this function's own frame, so that it is the same for both phases
+
+void *
+TestStackUsage::stackThread(void *arg)
+{
+    StackRun *s = (StackRun *)arg;
+    char *entry = (char *)__builtin_frame_address(0);
+
+    if (s->phase == StackRun::Initialise) {
+        TestStackUsage t;
+        s->initialised = t.initDefaults(s->plugin, s->channels,
+                                        s->step, s->block, s->results);
+    } else {
+        float **ptr = new float *[s->channels];
+        for (size_t i = 0; i < s->count; ++i) {
+            size_t idx = i * s->step;
+            for (size_t c = 0; c < s->channels; ++c) {
+                ptr[c] = s->data[c] + idx;
+            }
+            s->plugin->process(ptr, RealTime::frame2RealTime(idx, s->rate));
+        }
+        s->plugin->getRemainingFeatures();
+        delete[] ptr;
+    }
+
+    s->used = entry - stackHighWater(s->low, entry);
+    return 0;
+}
+
+#endif
+
+Test::Results
+TestStackUsage::test(string key, Options options)
+{
+    int rate = 44100;
+    Results r;
+
+#ifdef _WIN32
+    r.push_back(note("Stack use cannot be measured on this platform"));
+    return r;
+#else
+    unique_ptr<Plugin> p(load(key, rate));
+
+    // The stack is mapped by us rather than by the thread library so
+    // that we know exactly where it lies and can fill it with the
+    // pattern first. It is a good deal larger than the limit, so that
+    // a plugin exceeding the limit is reported rather than crashing,
+    // and the page at its low end is a guard against overflow
+    long long limit = stackLimit();
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = max(size_t(8 * 1048576), size_t(limit) * 4);
+    size = (size + page - 1) / page * page;
+    char *base = (char *)mmap(0, size + page, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (base == (char *)MAP_FAILED) {
+        r.push_back(note("Stack use cannot be measured: failed to allocate a stack"));
+        return r;
+    }
+    mprotect(base, page, PROT_NONE);
+
+    // Initialise, and then process and getRemainingFeatures, each on
+    // its own thread running on the stack freshly filled with the
+    // pattern. The plugin instance is only used by one thread at a time
+
+    StackRun s;
+    s.plugin = p.get();
+    s.low = base + page;
+    s.rate = rate;
+    s.channels = s.step = s.block = 0;
+    s.data = 0;
+    s.count = 0;
+    s.initialised = false;
+
+    auto runPhase = [&](StackRun::Phase phase) -> bool {
+        s.phase = phase;
+        s.used = 0;
+        uintptr_t *w = (uintptr_t *)s.low;
+        for (size_t i = 0; i < size / sizeof(uintptr_t); ++i) {
+            w[i] = _stackPattern;
+        }
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setstack(&attr, s.low, size);
+        pthread_t thread;
+        int rv = pthread_create(&thread, &attr, stackThread, &s);
+        pthread_attr_destroy(&attr);
+        if (rv != 0) return false;
+        pthread_join(thread, 0);
+        return true;
+    };
+
+    if (!runPhase(StackRun::Initialise)) {
+        munmap(base, size + page);
+        r.push_back(note("Stack use cannot be measured: failed to start a thread with our own stack"));
+        return r;
+    }
+    long long initUsed = s.used;
+
+    r.insert(r.end(), s.results.begin(), s.results.end());
+    if (!s.initialised) {
+        munmap(base, size + page);
+        return r;
+    }
+
+    // 10 seconds of audio, in the plugin's preferred block size
+    size_t total = max(size_t(rate * 10), s.block);
+    s.count = (total - s.block) / s.step + 1;
+    s.data = createTestAudio(s.channels, 1, total);
+
+    bool processed = runPhase(StackRun::Process);
+    long long processUsed = s.used;
+
+    destroyTestAudio(s.data, s.channels);
+    munmap(base, size + page);
+
+    if (!processed) {
+        r.push_back(note("Stack use cannot be measured: failed to start a thread with our own stack"));
+        return r;
+    }
+
+    if (options & Verbose) {
+        cout << "    Stack: " << formatBytes(initUsed) << " in initialise, "
+             << formatBytes(processUsed)
+             << " in process and getRemainingFeatures, of "
+             << formatBytes(size) << " available" << endl;
+    }
+
+    // Usage is only noted when it is getting close to the limit, as
+    // otherwise it would add a note for every plugin
+    long long used = max(initUsed, processUsed);
+    if (used > limit) {
+        if (initUsed > limit) {
+            r.push_back(error("Plugin uses " + formatBytes(initUsed) + " of stack in initialise, more than the limit of " + formatBytes(limit)));
+        }
+        if (processUsed > limit) {
+            r.push_back(error("Plugin uses " + formatBytes(processUsed) + " of stack in process, more than the limit of " + formatBytes(limit)));
+        }
+    } else if (used > limit / 2) {
+        r.push_back(note("Stack used: " + formatBytes(initUsed) + " in initialise, " + formatBytes(processUsed) + " in process, more than half the limit of " + formatBytes(limit)));
+    }
+
+    return r;
+#endif
+}
@@ -0,0 +1,550 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Vamp Plugin Tester
+    Chris Cannam, cannam@all-day-breakfast.com
+    Centre for Digital Music, Queen Mary, University of London.
+    Copyright 2009-2014 QMUL.
+
+    This program loads a Vamp plugin and tests its susceptibility to a
+    number of common pitfalls, including handling of extremes of input
+    data.  If you can think of any additional useful tests that are
+    easily added, please send them to me.
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of the Centre for
+    Digital Music; Queen Mary, University of London; and Chris Cannam
+    shall not be used in advertising or otherwise to promote the sale,
+    use or other dealings in this Software without prior written
+    authorization.
+*/
+
+
+#include "TestThreads.h"
+
+#include <vamp-hostsdk/Plugin.h>
+using namespace Vamp;
+
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <random>
+#include <functional>
+using namespace std;
+
+#include <cmath>
+
+Tester::TestRegistrar<TestInstanceScaling>
+TestInstanceScaling::m_registrar("G1", "Multi-threaded instance scaling", true);
+
+Tester::TestRegistrar<TestConcurrentRuns>
+TestConcurrentRuns::m_registrar("G2", "Simultaneous runs in separate threads");
+
+Tester::TestRegistrar<TestThreadMigration>
+TestThreadMigration::m_registrar("G3", "Consecutive process calls on different threads");
+
+static const size_t _step = 1000;
+
+// Holds back each thread that calls wait() until the expected number
+// of threads have done so, then releases them all together
+
+class Barrier
+{
+public:
+    Barrier(int n) : m_n(n), m_waiting(0), m_generation(0) { }
+
+    void wait() {
+        unique_lock<mutex> lock(m_mutex);
+        int generation = m_generation;
+        if (++m_waiting == m_n) {
+            m_waiting = 0;
+            ++m_generation;
+            m_condition.notify_all();
+        } else {
+            m_condition.wait(lock, [&] { return generation != m_generation; });
+        }
+    }
+
+private:
+    int m_n;
+    int m_waiting;
+    int m_generation;
+    mutex m_mutex;
+    condition_variable m_condition;
+};
+
+// Runs jobs on a fixed set of worker threads, one job at a time, with
+// the caller choosing which worker runs each job and waiting for it to
+// complete. The mutex hand-off ensures that each job sees the effects
+// of the previous one, whichever thread that ran on
+
+class Dispatcher
+{
+public:
+    Dispatcher(int workers) : m_next(-1), m_done(false), m_quit(false) {
+        for (int i = 0; i < workers; ++i) {
+            m_threads.push_back(thread(&Dispatcher::work, this, i));
+        }
+    }
+
+    ~Dispatcher() {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_condition.notify_all();
+        for (int i = 0; i < int(m_threads.size()); ++i) m_threads[i].join();
+    }
+
+    void dispatch(int worker, function<void()> job) {
+        unique_lock<mutex> lock(m_mutex);
+        m_job = job;
+        m_next = worker;
+        m_done = false;
+        m_condition.notify_all();
+        m_condition.wait(lock, [&] { return m_done; });
+    }
+
+private:
+    void work(int index) {
+        unique_lock<mutex> lock(m_mutex);
+        while (true) {
+            m_condition.wait(lock, [&] { return m_quit || m_next == index; });
+            if (m_quit) return;
+            m_next = -1;
+            m_job();
+            m_done = true;
+            m_condition.notify_all();
+        }
+    }
+
+    vector<thread> m_threads;
+    mutex m_mutex;
+    condition_variable m_condition;
+    function<void()> m_job;
+    int m_next;
+    bool m_done;
+    bool m_quit;
+};
+
+void
+TestInstanceScaling::run(Plugin *p, float **data, size_t channels,
+                         size_t count, int rate, Barrier *barrier,
+                         long long *start, long long *end,
+                         string *exception)
+{
+    // An exception escaping a thread would terminate the tester, so
+    // it is caught here and reported by the caller
+    float **ptr = new float *[channels];
+    barrier->wait();
+    *start = nanoseconds();
+    try {
+        for (size_t i = 0; i < count; ++i) {
+            size_t idx = i * _step;
+            for (size_t c = 0; c < channels; ++c) ptr[c] = data[c] + idx;
+            RealTime timestamp = RealTime::frame2RealTime(idx, rate);
+            p->process(ptr, timestamp);
+        }
+        p->getRemainingFeatures();
+    } catch (const std::exception &e) {
+        *exception = e.what();
+    } catch (...) {
+        *exception = "unknown exception";
+    }
+    *end = nanoseconds();
+    delete[] ptr;
+}
+
+// Parallel efficiency below which we warn that a plugin scales
+// badly. This is only applied up to the number of physical cores, as
+// instances sharing a core through simultaneous multithreading
+// compete for its execution units whatever the plugin does
+static const double _efficiencyThreshold = 0.5;
+
+Test::Results
+TestInstanceScaling::test(string key, Options)
+{
+    int rate = 44100;
+    Results r;
+    size_t channels = 0;
+    size_t count = 1000;
+    const int trials = 3;
+
+    int maxThreads = threadCount();
+    vector<int> threadCounts;
+    for (int n = 1; n < maxThreads; n *= 2) threadCounts.push_back(n);
+    threadCounts.push_back(maxThreads);
+
+    double single = 0.0;
+    int cores = physicalCores();
+    if (cores > 0) {
+        cout << "    " << cores << " physical core(s)" << endl;
+    }
+
+    cout << "    " << setw(12) << left << "Instances"
+         << setw(20) << "Throughput" << "Efficiency" << endl;
+
+    for (int ni = 0; ni < int(threadCounts.size()); ++ni) {
+
+        int n = threadCounts[ni];
+
+        // Load and initialise on this thread, as the loader is not
+        // thread-safe; only the processing is concurrent
+
+        vector<Plugin *> plugins;
+        vector<float **> data;
+        for (int i = 0; i < n; ++i) {
+            plugins.push_back(load(key, rate));
+            if (!initAdapted(plugins[i], channels, _step, _step, r)) {
+                for (int j = 0; j <= i; ++j) delete plugins[j];
+                for (int j = 0; j < i; ++j) destroyTestAudio(data[j], channels);
+                return r;
+            }
+            data.push_back(createTestAudio(channels, _step, count));
+        }
+
+        long long best = 0;
+
+        for (int trial = 0; trial < trials; ++trial) {
+            if (trial > 0) {
+                for (int i = 0; i < n; ++i) plugins[i]->reset();
+            }
+            Barrier barrier(n);
+            vector<long long> start(n), end(n);
+            vector<string> exceptions(n);
+            vector<thread> threads;
+            for (int i = 0; i < n; ++i) {
+                threads.push_back(thread(run, plugins[i], data[i], channels,
+                                         count, rate, &barrier,
+                                         &start[i], &end[i],
+                                         &exceptions[i]));
+            }
+            for (int i = 0; i < n; ++i) threads[i].join();
+            for (int i = 0; i < n; ++i) {
+                if (exceptions[i] == "") continue;
+                r.push_back(error("Plugin threw an exception with " + to_string(n) + " concurrent instance(s): " + exceptions[i]));
+                for (int j = 0; j < n; ++j) {
+                    delete plugins[j];
+                    destroyTestAudio(data[j], channels);
+                }
+                cout << right;
+                return r;
+            }
+            long long first = start[0], last = end[0];
+            for (int i = 1; i < n; ++i) {
+                if (start[i] < first) first = start[i];
+                if (end[i] > last) last = end[i];
+            }
+            if (trial == 0 || last - first < best) best = last - first;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            delete plugins[i];
+            destroyTestAudio(data[i], channels);
+        }
+
+        if (best < 1) best = 1;
+
+        // Throughput as a multiple of real-time, across all instances
+        double throughput =
+            (double(n) * count * _step / rate) / (double(best) / 1e9);
+        if (n == 1) single = throughput;
+        double efficiency = throughput / (n * single);
+
+        ostringstream ts, es;
+        ts << fixed << setprecision(1) << throughput << "x real-time";
+        es << fixed << setprecision(0) << efficiency * 100 << "%";
+        cout << "    " << setw(12) << left << n
+             << setw(20) << ts.str() << es.str() << endl;
+
+        if (efficiency < _efficiencyThreshold && (cores < 0 || n <= cores)) {
+            r.push_back(warning("Plugin scales poorly across threads: parallel efficiency with " + to_string(n) + " concurrent instances is only " + es.str() + " (shared state or locking in plugin?)"));
+        }
+
+        if (n > 1 && ni + 1 == int(threadCounts.size())) {
+            r.push_back(note("Aggregate throughput with " + to_string(n) +
+                             " concurrent instances is " + ts.str() +
+                             ", parallel efficiency " + es.str()));
+        }
+    }
+
+    cout << right;
+
+    if (maxThreads == 1) {
+        r.push_back(note("Only one thread available, so scaling could not be measured (use --threads to override)"));
+    }
+
+    return r;
+}
+
+void
+TestConcurrentRuns::run(Plugin *p, float **data, size_t channels,
+                        size_t count, int rate, Barrier *barrier,
+                        bool lockstep, unsigned int seed,
+                        vector<Plugin::FeatureSet> *out)
+{
+    minstd_rand random(seed);
+    float **ptr = new float *[channels];
+    barrier->wait();
+    for (size_t i = 0; i < count; ++i) {
+        if (lockstep) {
+            barrier->wait();
+        } else if (seed != 0) {
+            int yields = random() % 4;
+            for (int y = 0; y < yields; ++y) this_thread::yield();
+        }
+        size_t idx = i * _step;
+        for (size_t c = 0; c < channels; ++c) ptr[c] = data[c] + idx;
+        RealTime timestamp = RealTime::frame2RealTime(idx, rate);
+        out->push_back(p->process(ptr, timestamp));
+    }
+    out->push_back(p->getRemainingFeatures());
+    delete[] ptr;
+}
+
+Test::Results
+TestConcurrentRuns::test(string key, Options options)
+{
+    int rate = 44100;
+    Results r;
+    size_t channels = 0;
+    size_t count = 100;
+
+    // Rounds differ in how the threads' process calls are interleaved:
+    // the first runs them in lock-step, the second lets them run
+    // freely, and the rest perturb the timing with a pseudo-random
+    // (but repeatable) number of yields before each block
+    const int rounds = 4;
+
+    int n = threadCount();
+    if (n < 2) n = 2;
+    if (n > 8) n = 8;
+
+    // Serial reference run, one instance on its own
+    vector<Plugin::FeatureSet> reference;
+    float **data = 0;
+    {
+        unique_ptr<Plugin> p(load(key, rate));
+        if (!initAdapted(p.get(), channels, _step, _step, r)) return r;
+        data = createTestAudio(channels, _step, count);
+        Barrier barrier(1);
+        run(p.get(), data, channels, count, rate, &barrier,
+            false, 0, &reference);
+    }
+
+    int firstBlock = -1;
+    Plugin::FeatureSet expected, obtained;
+
+    for (int round = 0; round < rounds; ++round) {
+
+        vector<Plugin *> plugins;
+        for (int i = 0; i < n; ++i) {
+            plugins.push_back(load(key, rate));
+            if (!initAdapted(plugins[i], channels, _step, _step, r)) {
+                for (int j = 0; j <= i; ++j) delete plugins[j];
+                destroyTestAudio(data, channels);
+                return r;
+            }
+        }
+
+        Barrier barrier(n);
+        vector<vector<Plugin::FeatureSet> > out(n);
+        vector<thread> threads;
+        for (int i = 0; i < n; ++i) {
+            unsigned int seed = (round < 2 ? 0 : round * 1000 + i + 1);
+            threads.push_back(thread(run, plugins[i], data, channels,
+                                     count, rate, &barrier,
+                                     round == 0, seed, &out[i]));
+        }
+        for (int i = 0; i < n; ++i) {
+            threads[i].join();
+            delete plugins[i];
+        }
+
+        for (int i = 0; i < n; ++i) {
+            for (int b = 0; b < int(reference.size()); ++b) {
+                if (firstBlock >= 0 && b >= firstBlock) break;
+                if (!(out[i][b] == reference[b])) {
+                    firstBlock = b;
+                    expected = reference[b];
+                    obtained = out[i][b];
+                    break;
+                }
+            }
+        }
+    }
+
+    destroyTestAudio(data, channels);
+
+    if (firstBlock >= 0) {
+        string where;
+        if (firstBlock == int(count)) {
+            where = "in getRemainingFeatures";
+        } else {
+            where = "at block " + to_string(firstBlock) + " (" +
+                RealTime::frame2RealTime(firstBlock * _step, rate).toText() +
+                ")";
+        }
+        string message = "Simultaneous runs in separate threads produce results different from a serial run, first differing " + where;
+        Result res;
+        if (options & NonDeterministic) res = note(message);
+        else res = error(message);
+        if (options & Verbose) dumpDiff(res, expected, obtained);
+        r.push_back(res);
+    } else {
+        r.push_back(success());
+    }
+
+    return r;
+}
+
+long long
+TestThreadMigration::runDispatched(Plugin *p, float **data,
+                                   size_t channels, size_t count, int rate,
+                                   Dispatcher *dispatcher, int workers,
+                                   Plugin::FeatureSet &f)
+{
+    // With no dispatcher, everything happens on the calling thread;
+    // otherwise each call goes to the next of the given number of
+    // workers in turn. The time returned is that spent inside the
+    // plugin's own calls, measured on whichever thread made them, so
+    // that it excludes the cost of waking the workers
+    
+    float **ptr = new float *[channels];
+    long long busy = 0;
+    for (size_t i = 0; i <= count; ++i) {
+        function<void()> job;
+        if (i < count) {
+            size_t idx = i * _step;
+            for (size_t c = 0; c < channels; ++c) ptr[c] = data[c] + idx;
+            RealTime timestamp = RealTime::frame2RealTime(idx, rate);
+            job = [&, timestamp] {
+                long long start = nanoseconds();
+                Plugin::FeatureSet fs = p->process(ptr, timestamp);
+                busy += nanoseconds() - start;
+                appendFeatures(f, fs);
+            };
+        } else {
+            job = [&] {
+                long long start = nanoseconds();
+                Plugin::FeatureSet fs = p->getRemainingFeatures();
+                busy += nanoseconds() - start;
+                appendFeatures(f, fs);
+            };
+        }
+        if (dispatcher) dispatcher->dispatch(i % workers, job);
+        else job();
+    }
+    delete[] ptr;
+    return busy;
+}
+
+Test::Results
+TestThreadMigration::test(string key, Options options)
+{
+    int rate = 44100;
+    Results r;
+    size_t channels = 0;
+    size_t count = 200;
+    float **data = 0;
+
+    int n = threadCount();
+    if (n < 2) n = 2;
+    if (n > 8) n = 8;
+
+    // The pinned and migrating runs are timed as the best of several
+    // trials, and only compared at all if the plugin spends long
+    // enough processing for the comparison to mean anything
+    const int trials = 5;
+    const long long minimumTime = 20000000; // 20ms
+
+    // Three runs: entirely on this thread; initialised on this thread
+    // and processed on a single worker ("pinned"); and initialised on
+    // this thread with each process call going to the next of several
+    // workers in rotation ("migrating"). The latter two both pass
+    // every call through the dispatcher, but only the time inside the
+    // plugin's calls is compared
+    
+    enum { Local, Pinned, Migrating, Runs };
+    Plugin::FeatureSet f[Runs];
+    long long elapsed[Runs];
+
+    Dispatcher dispatcher(n);
+
+    for (int run = 0; run < Runs; ++run) {
+        unique_ptr<Plugin> p(load(key, rate));
+        if (!initAdapted(p.get(), channels, _step, _step, r)) {
+            if (data) destroyTestAudio(data, channels);
+            return r;
+        }
+        if (!data) data = createTestAudio(channels, _step, count);
+        elapsed[run] = runDispatched(p.get(), data, channels, count, rate,
+                                     run == Local ? 0 : &dispatcher,
+                                     run == Migrating ? n : 1,
+                                     f[run]);
+        for (int trial = 1; run != Local && trial < trials; ++trial) {
+            p->reset();
+            Plugin::FeatureSet scratch;
+            elapsed[run] = min(elapsed[run],
+                               runDispatched(p.get(), data, channels,
+                                             count, rate, &dispatcher,
+                                             run == Migrating ? n : 1,
+                                             scratch));
+        }
+    }
+
+    destroyTestAudio(data, channels);
+
+    if (options & Verbose) {
+        cout << "    Process time when pinned to one thread: "
+             << formatDuration(elapsed[Pinned]) << endl;
+        cout << "    Process time when migrating between " << n
+             << " threads: " << formatDuration(elapsed[Migrating]) << endl;
+        if (elapsed[Pinned] < minimumTime) {
+            cout << "    (too short to compare reliably)" << endl;
+        }
+    }
+
+    if (!(f[Local] == f[Migrating])) {
+        string message = "Process calls made on different threads produce different results from those made on the initialising thread";
+        Result res;
+        if (options & NonDeterministic) res = note(message);
+        else res = error(message);
+        if (options & Verbose) dumpDiff(res, f[Local], f[Migrating]);
+        r.push_back(res);
+    } else {
+        r.push_back(success());
+    }
+
+    if (elapsed[Pinned] >= minimumTime &&
+        double(elapsed[Migrating]) / elapsed[Pinned] > 2.0) {
+        ostringstream os;
+        os << fixed << setprecision(1)
+           << double(elapsed[Migrating]) / elapsed[Pinned];
+        r.push_back(warning("Processing is " + os.str() + " times slower when process calls move between threads than when they stay on one thread (thread-local caches or thread affinity?)"));
+    }
+
+    return r;
+}
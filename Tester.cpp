@@ -93,7 +93,9 @@ Tester::listTests()
     cout << "---+-----" << endl;
     for (NameIndex::const_iterator i = nameIndex().begin();
          i != nameIndex().end(); ++i) {
-        cout << i->first << " | " << i->second << endl;
+        cout << i->first << " | " << i->second;
+        if (registry()[i->first]->isBenchmark()) cout << " (benchmark)";
+        cout << endl;
     }
     cout << endl;
 }
@@ -125,6 +127,9 @@ Tester::test(int &notes, int &warnings, int &errors)
 
       * Plugin returns different results if another instance is
         constructed and run "interleaved" with it (from same thread) - DONE
+
+      * Plugin returns different results if other instances are run
+        at the same time in separate threads - DONE
  
       * Plugin's returned timestamps do not change as expected when
         run with a different base timestamp for input (though there
@@ -187,6 +192,11 @@ Tester::test(int &notes, int &warnings, int &errors)
             for (Registry::const_iterator i = registry().begin();
                  i != registry().end(); ++i) {
 
+                if (i->second->isBenchmark() &&
+                    !(m_options & Test::Benchmarks)) {
+                    continue;
+                }
+
                 bool thisGood = performTest(i->first, notes, warnings, errors);
                 if (!thisGood) good = false;
             }
@@ -56,18 +56,28 @@ public:
 
     class Registrar {
     public:
-        Registrar(std::string id, std::string name) { 
+        Registrar(std::string id, std::string name, bool benchmark) :
+            m_benchmark(benchmark) { 
             Tester::registerTest(id, name, this);
         }
         virtual ~Registrar() { }
         virtual Test *makeTest() = 0;
+
+        // Benchmarks report measurements rather than pass/fail, and
+        // may take a long time, so they are only included in the full
+        // suite if the Benchmarks option is given
+        bool isBenchmark() const { return m_benchmark; }
+
+    protected:
+        bool m_benchmark;
     };
     
     template <typename T>
     class TestRegistrar : Registrar {
     public:
-        TestRegistrar(std::string id, std::string name) : 
-            Registrar(id, name) { }
+        TestRegistrar(std::string id, std::string name,
+                      bool benchmark = false) : 
+            Registrar(id, name, benchmark) { }
         virtual Test *makeTest() { return new T(); }
     };
 
@@ -60,8 +60,9 @@ void usage(const char *name)
         "Copyright 2009-2015 QMUL.\n"
         "Freely redistributable; published under a BSD-style license.\n\n"
         "Usage:\n"
-        "  " << name << " [-nv] [-t <test>] <pluginbasename>:<plugin>\n"
-        "  " << name << " [-nv] [-t <test>] -a\n"
+        "  " << name << " [-nvb] [-t <test>] <pluginbasename>:<plugin>\n"
+        "  " << name << " [-nvb] [-t <test>] -a\n"
+        "  " << name << " [-nv] --soak <duration> <pluginbasename>:<plugin>\n"
         "  " << name << " -l\n\n"
         "Example:\n"
         "  " << name << " vamp-example-plugins:amplitudefollower\n\n"
@@ -71,6 +72,18 @@ void usage(const char *name)
         "                            instead of an error if results differ between runs\n\n"
         "  -v, --verbose             Show returned features each time a note, warning,\n"
         "                            or error arises from feature data\n\n"
+        "  -b, --benchmark           Include the performance benchmarks in the test\n"
+        "                            suite. These print measurements and may take a\n"
+        "                            long time to run\n\n"
+        "  --soak <duration>         Run only the long-running soak test, streaming\n"
+        "                            the given duration of input through the plugin,\n"
+        "                            e.g. 600, 90m or 10h (seconds by default)\n\n"
+        "  --threads <n>             Run up to <n> plugin instances concurrently in the\n"
+        "                            multi-threaded tests (default is the number of\n"
+        "                            processor cores)\n\n"
+        "  --stack-limit <size>      Report an error if a plugin uses more than <size>\n"
+        "                            of stack in initialise or process, e.g. 65536,\n"
+        "                            64k or 1m (default 256k)\n\n"
         "  -t, --test <test>         Run only a single test, not the full test suite.\n"
         "                            Identify the test by its id, e.g. A3\n\n"
         "  -l, --list-tests          List tests by id and name\n\n"
@@ -81,6 +94,32 @@ void usage(const char *name)
     exit(2);
 }
 
+// Parse a duration such as "600", "600s", "90m" or "10h", returning
+// seconds, or 0 if it can't be parsed
+double parseDuration(const char *arg)
+{
+    char *end = 0;
+    double value = strtod(arg, &end);
+    if (end == arg || value <= 0.0) return 0.0;
+    if (!strcmp(end, "") || !strcmp(end, "s")) return value;
+    if (!strcmp(end, "m")) return value * 60.0;
+    if (!strcmp(end, "h")) return value * 3600.0;
+    return 0.0;
+}
+
+// Parse a size such as "65536", "64k" or "1m", returning bytes, or 0
+// if it can't be parsed
+long long parseSize(const char *arg)
+{
+    char *end = 0;
+    double value = strtod(arg, &end);
+    if (end == arg || value <= 0.0) return 0;
+    if (!strcmp(end, "")) return (long long)value;
+    if (!strcmp(end, "k") || !strcmp(end, "K")) return (long long)(value * 1024);
+    if (!strcmp(end, "m") || !strcmp(end, "M")) return (long long)(value * 1048576);
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     char *scooter = argv[0];
@@ -95,6 +134,8 @@ int main(int argc, char **argv)
     bool verbose = false;
     bool all = false;
     bool list = false;
+    bool benchmarks = false;
+    bool soak = false;
     string plugin;
     string single;
 
@@ -123,6 +164,11 @@ int main(int argc, char **argv)
                 all = true;
                 continue;
             }
+            if (!strcmp(argv[i], "-b") ||
+                !strcmp(argv[i], "--benchmark")) {
+                benchmarks = true;
+                continue;
+            }
             if (!strcmp(argv[i], "-l") ||
                 !strcmp(argv[i], "--list-tests")) {
                 list = true;
@@ -138,6 +184,42 @@ int main(int argc, char **argv)
                 }
                 continue;
             }
+            if (!strcmp(argv[i], "--soak")) {
+                double seconds = 0.0;
+                if (i + 1 < argc) {
+                    seconds = parseDuration(argv[i+1]);
+                }
+                if (seconds > 0.0) {
+                    Test::setSoakDuration(seconds);
+                    soak = true;
+                    ++i;
+                } else {
+                    usage(name);
+                }
+                continue;
+            }
+            if (!strcmp(argv[i], "--threads")) {
+                if (i + 1 < argc && atoi(argv[i+1]) > 0) {
+                    Test::setThreadCount(atoi(argv[i+1]));
+                    ++i;
+                } else {
+                    usage(name);
+                }
+                continue;
+            }
+            if (!strcmp(argv[i], "--stack-limit")) {
+                long long bytes = 0;
+                if (i + 1 < argc) {
+                    bytes = parseSize(argv[i+1]);
+                }
+                if (bytes > 0) {
+                    Test::setStackLimit(bytes);
+                    ++i;
+                } else {
+                    usage(name);
+                }
+                continue;
+            }
             if (!strcmp(argv[i], "--version")) {
                 cout << "v" << VERSION << endl;
                 return 0;
@@ -150,13 +232,19 @@ int main(int argc, char **argv)
     }
 
     if (list) {
-        if (all || nondeterministic || (single != "") || (plugin != "")) {
+        if (all || nondeterministic || benchmarks || soak ||
+            (single != "") || (plugin != "")) {
             usage(name);
         }
         Tester::listTests();
         return 0;
     }
     
+    if (soak) {
+        if (single != "") usage(name);
+        single = "H1";
+    }
+
     if (plugin == "" && !all) usage(name);
     if (plugin != "" &&  all) usage(name);
 
@@ -166,6 +254,7 @@ int main(int argc, char **argv)
     if (nondeterministic) opts |= Test::NonDeterministic;
     if (verbose) opts |= Test::Verbose;
     if (single != "") opts |= Test::SingleTest;
+    if (benchmarks) opts |= Test::Benchmarks;
 
     if (all) {
         bool good = true;